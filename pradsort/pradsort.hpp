@@ -27,13 +27,25 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 #define PRADSORT_HPP
 
 #include <cstdlib>
+#include <cstdio>
+#include <climits>
+#include <stdint.h>
+#include <type_traits>
+#include <limits>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
 #ifdef linux
 #include <sys/time.h>
 #include <parallel/algorithm>
 #include <unistd.h>
 #include <string.h>
 #include <syscall.h>
+#include <sched.h>
+#include <stdio.h>
 #include <numa.h>
+#include <numaif.h>
+#include <sys/mman.h>
 #endif
 #ifdef _WIN32
 #include <string.h>
@@ -41,13 +53,19 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 #endif
 
 
+// Macros below NUMA, NODE_BIND, CPU_BIND, FIRST_TOUCH, PAGE_SIZE_INCLUDED and LOCAL_SCRATCH are default values
+// of the placement policy, which can be changed at run time (see Policy)
+
 #define NUMA 0 // 0 - initialization using new
 // 1 - array initialized in interleaved mode
-// 2 - array set to interleave mode nodes before in insertValues function
+// 2 - parts of arrays are placed on Numa nodes of threads which use them
 
 #define NODE_BIND 1 // 0 - no binding
-// 1 - half of threads are bound to one NUMA node, rest to second NUMA node(eg. 12 threads, 6 are bound to first node, 6 to second)
-// 2 - before 9th thread, threads are bound to first NUMA node, then to second node( eg. 12 threads, 8 are bound to first node, 4 to second)
+// 1 - threads are spread over all NUMA nodes in proportion to their cores
+//     (eg. 12 threads on two nodes of 8 cores, 6 are bound to first node, 6 to second)
+// 2 - threads are bound to NUMA nodes in order, each node gets as many threads as it has cores
+//     (eg. 12 threads on two nodes of 8 cores, 8 are bound to first node, 4 to second)
+// nodes and their cores are discovered at run time (see NumaTopology)
 
 #define CPU_BIND 1 // 0 - no binding
 // 1 - threads are bound to CPU cores
@@ -58,6 +76,74 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 
 #define PAGE_SIZE_INCLUDED 0 // data is split in 4096 bytes blocks( 1024 int elements)
 
+#define LOCAL_SCRATCH 1 // 0 - work space of threads (bit intervals, histograms, buffers) is allocated by the calling thread
+// 1 - work space of each thread is allocated in whole pages on its Numa node and first touched by the thread itself
+
+#define WRITE_COMBINE 2 // 0 - values and keys are written directly into output arrays
+// 1 - values and keys are staged in per-thread cache line buffers of each bit interval
+//     and full lines are written with streaming (non-temporal) stores
+// 2 - as 1, but only for digits of 8 and more bits
+
+#define WRITE_COMBINE_BITS 12 // write combining buffers are used only for digits of up to WRITE_COMBINE_BITS bits
+// (buffers of all bit intervals of longer digits do not fit in cache, values are written directly)
+
+#define CACHE_LINE 64 // size of cache line in bytes
+
+#define FUSED_COUNT 1 // 0 - each pass counts digits of threads in a separate read of the array
+// 1 - digits of the next pass are counted while values are inserted (several threads only)
+
+#define FUSED_COUNT_BITS 15 // digits of the next pass are counted while values are inserted only when their counters
+// for the parts of all threads fit in 2^FUSED_COUNT_BITS counters of each thread, kept in L2 cache
+// (e.g. 8-bit digits of up to 126 threads, 11-bit digits of up to 14 threads)
+
+#define COUNTING_SORT_BITS 16 // values whose keys differ by less than 2^COUNTING_SORT_BITS
+// are sorted by counting sort instead of several radix passes (0 - no counting sort)
+
+#define MERGE_RUNS 16 // arrays of at most MERGE_RUNS sorted runs are merged instead of sorted by radix passes
+// when merging takes fewer rounds than passes (0 - only sorted and reverse sorted arrays are recognized)
+
+#define THREAD_VALUES 16384 // minimal number of values sorted by one thread, so shorter arrays are sorted by fewer threads
+// and arrays of less than 2 x THREAD_VALUES values by the calling thread alone, without parallel regions
+// (0 - all threads sort arrays of any length)
+
+#define INVERT_WALKS 32 // number of cycles of keys walked together by each thread when keys are inverted in place,
+// so reads of their keys wait for memory at the same time (1 - one cycle after another)
+
+#define HISTOGRAM_LANES 4 // number of sub-histograms counted by each thread, so repeated digits
+// do not wait for the increment of the same counter (1 - single histogram)
+
+#define HISTOGRAM_LANE_BITS 12 // sub-histograms are used only for digits of up to HISTOGRAM_LANE_BITS bits
+
+#define CPU_DISPATCH 1 // 0 - only portable kernels
+// 1 - kernels for AVX2 and AVX-512 are chosen at run time when the CPU supports them (GCC and Clang on x86)
+
+#define TUNE 1 // 0 - digit width and number of threads of bitCount 0 are chosen by the default cost model
+// 1 - cost model measured by calibrate is loaded from the file of the host when it exists
+// 2 - as 1, but calibrate is run when the file holds no model for the size of values
+
+#define TUNE_BITS 16 // cost model holds costs of digits of up to TUNE_BITS bits
+// (bitCount 0 chooses digits of up to TUNE_BITS bits, digits of longer bitCount are not balanced)
+
+#define NAN_PLACEMENT 1 // 0 - float and double NaNs are placed by IEEE-754 total order
+//     (NaNs with sign bit before -inf, other NaNs after +inf)
+// 1 - all NaNs are placed after +inf
+
+// prefix sums are vectorized by scan reductions of OpenMP 5.0
+// (GCC supports them since version 10, but it reports an older version of OpenMP)
+#if _OPENMP >= 201811 || (defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 10)
+#define OMP_SCAN 1
+#else
+#define OMP_SCAN 0
+#endif
+
+// kernels for other instruction sets are compiled with target attributes
+#if CPU_DISPATCH==1 && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define X86_DISPATCH 1
+#include <immintrin.h>
+#else
+#define X86_DISPATCH 0
+#endif
+
 using namespace std;
 
 // Timer class created to count time for each part of algorithm. 
@@ -80,15 +166,415 @@ public:
     virtual void finish(int timer) = 0;    
               
 };
-// Thread data
+
+// Placement policy of threads and memory.
+// Default policy is given by macros, field values have the same meaning as values of macros.
+//
+struct Policy {
+
+	// allocation of temporary arrays (see NUMA)
+	int numa;
+
+	// binding threads to Numa nodes (see NODE_BIND)
+	int nodeBind;
+
+	// binding threads to CPU cores (see CPU_BIND)
+	int cpuBind;
+
+	// first touch of temporary arrays (see FIRST_TOUCH)
+	int firstTouch;
+
+	// values are split between threads in whole pages (see PAGE_SIZE_INCLUDED)
+	bool pageSizeIncluded;
+
+	// placement of work space of threads (see LOCAL_SCRATCH)
+	int localScratch;
+
+	Policy() {
+		numa = NUMA;
+		nodeBind = NODE_BIND;
+		cpuBind = CPU_BIND;
+		firstTouch = FIRST_TOUCH;
+		pageSizeIncluded = PAGE_SIZE_INCLUDED == 1;
+		localScratch = LOCAL_SCRATCH;
+	}
+};
+
+/* Allocating memory aligned to the cache line
+ *
+ * size - size of memory in bytes
+ */
+inline void * alignedAlloc(size_t size) {
+	void *pointer = NULL;
+#ifdef linux
+	if (posix_memalign(&pointer, CACHE_LINE, size) != 0)
+		pointer = NULL;
+#endif
+#ifdef _WIN32
+	pointer = _aligned_malloc(size, CACHE_LINE);
+#endif
+	return pointer;
+}
+
+/* Releasing memory allocated by alignedAlloc
+ *
+ * pointer - allocated memory
+ */
+inline void alignedFree(void *pointer) {
+#ifdef linux
+	free(pointer);
+#endif
+#ifdef _WIN32
+	_aligned_free(pointer);
+#endif
+}
+
+/* Binding pages of local work space to a Numa node, pages faulted in already are moved to it
+ * (nothing without Numa support)
+ *
+ * pointer - work space allocated by scratchAlloc
+ * size - size of memory in bytes
+ * node - Numa node
+ */
+inline void scratchBind(void *pointer, size_t size, int node) {
+#ifdef linux
+	if (pointer == NULL || size == 0 || numa_available() < 0)
+		return;
+	size_t const page = (size_t) sysconf(_SC_PAGESIZE);
+	struct bitmask *nodes = numa_allocate_nodemask();
+	numa_bitmask_setbit(nodes, node);
+	mbind(pointer, (size + page - 1) / page * page, MPOL_BIND, nodes->maskp, nodes->size + 1, MPOL_MF_MOVE);
+	numa_free_nodemask(nodes);
+#endif
+}
+
+/* Allocating zeroed work space of a thread (see LOCAL_SCRATCH)
+ *
+ * Local work space takes whole pages of its own mapping bound to the Numa node of the thread, so work spaces
+ * of threads never share pages nor cache lines, and it is touched by the calling thread, which should be the thread itself.
+ * Released by scratchFree.
+ *
+ * size - size of memory in bytes
+ * node - Numa node of the thread
+ * local - work space is placed on the node of the thread (otherwise it is only aligned to the cache line)
+ */
+inline void * scratchAlloc(size_t size, int node, bool local) {
+	void *pointer = NULL;
+#ifdef linux
+	if (local) {
+		// a new mapping has no pages faulted in on other nodes, and its binding is dropped with it by scratchFree
+		// (pages reused by malloc after free would keep the binding)
+		pointer = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (pointer == MAP_FAILED)
+			return NULL;
+		scratchBind(pointer, size, node);
+	}
+#endif
+	if (pointer == NULL)
+		pointer = alignedAlloc(size);
+	if (pointer != NULL)
+		memset(pointer, 0, size);
+	return pointer;
+}
+
+/* Releasing work space allocated by scratchAlloc
+ *
+ * pointer - work space
+ * size - size of memory in bytes (as given to scratchAlloc)
+ * local - work space was placed on the node of the thread
+ */
+inline void scratchFree(void *pointer, size_t size, bool local) {
+#ifdef linux
+	if (local) {
+		if (pointer != NULL)
+			munmap(pointer, size);
+		return;
+	}
+#endif
+	(void) size;
+	(void) local;
+	alignedFree(pointer);
+}
+
+/* Counting pages of memory which lie on Numa node, returns the number of pages on the node
+ * (all pages lie on the node without Numa support)
+ *
+ * pointer - memory
+ * size - size of memory in bytes
+ * node - Numa node
+ * pages - output, the number of pages of memory is added to it
+ */
+inline size_t pagesOnNode(const void *pointer, size_t size, int node, size_t &pages) {
+	size_t local = 0;
+	if (pointer == NULL || size == 0)
+		return 0;
+#ifdef linux
+	uintptr_t const page = (uintptr_t) sysconf(_SC_PAGESIZE);
+	bool const numa = numa_available() >= 0;
+	for (uintptr_t address = (uintptr_t) pointer & ~(page - 1); address < (uintptr_t) pointer + size; address += page) {
+		void *first = (void *) address;
+		int status = node;
+		if (numa && numa_move_pages(0, 1, &first, NULL, &status, 0) != 0)
+			status = -1;
+		pages++;
+		if (status == node)
+			local++;
+	}
+#endif
+#ifdef _WIN32
+	pages++;
+	local++;
+#endif
+	return local;
+}
+
+/* Writing buffered bytes to memory with streaming stores (bypassing caches)
+ * when destination and size allow it, otherwise with ordinary stores
+ *
+ * dest - output memory
+ * src - buffered bytes
+ * size - number of bytes
+ */
+inline void streamBytes(void *dest, const void *src, size_t size) {
+#if defined(__SSE2__) || defined(_M_X64)
+	if ((((uintptr_t) dest | size) & 15) == 0) {
+		__m128i *destination = (__m128i *) dest;
+		const __m128i *source = (const __m128i *) src;
+		for (size_t i = 0; i < size / 16; i++)
+			_mm_stream_si128(destination + i, _mm_loadu_si128(source + i));
+		return;
+	}
+#endif
+	memcpy(dest, src, size);
+}
+
+/* Making streaming stores visible to other threads
+ */
+inline void streamFence() {
+#if defined(__SSE2__) || defined(_M_X64)
+	_mm_sfence();
+#endif
+}
+
+/* Loading memory which is read soon into caches (nothing without SSE2)
+ *
+ * pointer - memory
+ */
+inline void prefetch(const void *pointer) {
+#if defined(__SSE2__) || defined(_M_X64)
+	_mm_prefetch((const char *) pointer, _MM_HINT_T0);
+#else
+	(void) pointer;
+#endif
+}
+
+/* Instruction sets of the CPU for kernels chosen at run time (see CPU_DISPATCH)
+ *
+ * $PRADSORT_CPU (generic, avx2) limits them, e.g. to compare kernels on one host.
+ */
+struct CpuFeatures {
+
+	// AVX2
+	bool avx2;
+
+	// AVX-512 foundation with conflict detection and vector length extensions
+	bool avx512;
+
+	CpuFeatures() {
+		avx2 = false;
+		avx512 = false;
+#if X86_DISPATCH
+		__builtin_cpu_init();
+		avx2 = __builtin_cpu_supports("avx2");
+		avx512 = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512cd")
+				&& __builtin_cpu_supports("avx512vl");
+		const char *limit = getenv("PRADSORT_CPU");
+		if (limit != NULL && strcmp(limit, "avx512") != 0) {
+			avx512 = false;
+			avx2 = avx2 && strcmp(limit, "avx2") == 0;
+		}
+#endif
+	}
+};
+
+/* Instruction sets of the CPU (checked once)
+ */
+inline const CpuFeatures &cpuFeatures() {
+	static CpuFeatures features;
+	return features;
+}
+
+// Radix key of value - unsigned integer whose order is the order of values,
+// digits are taken from the key instead of the value.
+// Values of other types (unsigned integers, user types with >> and & operators) are their own keys.
+//
+template <class Ti, class Enable = void>
+struct RadixTraits {
+	typedef Ti Key;
+	static inline Key key(const Ti &value) {
+		return value;
+	}
+	static inline Ti value(const Key &key) {
+		return key;
+	}
+};
+
+// Signed integers - flipping the sign bit moves negative values before positive ones
 template <class Ti>
+struct RadixTraits<Ti, typename enable_if<is_integral<Ti>::value && is_signed<Ti>::value>::type> {
+	typedef typename make_unsigned<Ti>::type Key;
+	static inline Key key(const Ti &value) {
+		return (Key) value ^ ((Key) 1 << (8 * sizeof(Key) - 1));
+	}
+	static inline Ti value(const Key &key) {
+		return (Ti) (key ^ ((Key) 1 << (8 * sizeof(Key) - 1)));
+	}
+};
+
+// Floating point numbers - the sign bit is flipped for positive values and all bits
+// are flipped for negative values, which gives IEEE-754 total order
+//
+template <class Ti, class Tu, Tu infinity>
+struct FloatRadixTraits {
+	typedef Tu Key;
+	static inline Key key(const Ti &value) {
+		Key const sign = (Key) 1 << (8 * sizeof(Key) - 1);
+		Key bits;
+		memcpy(&bits, &value, sizeof(Key));
+#if NAN_PLACEMENT==1
+		// NaN loses its sign bit, so it is placed after +inf
+		bits &= ((bits & ~sign) > infinity) ? ~sign : ~(Key) 0;
+#endif
+		return bits ^ (((Key) 0 - (bits >> (8 * sizeof(Key) - 1))) | sign);
+	}
+	// NaNs placed after +inf have lost their sign bit
+	static inline Ti value(const Key &key) {
+		Key const sign = (Key) 1 << (8 * sizeof(Key) - 1);
+		Key bits = key ^ ((key & sign) ? sign : ~(Key) 0);
+		Ti value;
+		memcpy(&value, &bits, sizeof(Key));
+		return value;
+	}
+};
+
+template <>
+struct RadixTraits<float> : FloatRadixTraits<float, uint32_t, 0x7f800000u> {
+};
+
+template <>
+struct RadixTraits<double> : FloatRadixTraits<double, uint64_t, 0x7ff0000000000000ull> {
+};
+
+// Range of integer keys - values are sorted by their keys decreased by the minimal key,
+// so digits above the range of keys take one value and their passes are skipped.
+// Keys of other types are not reduced.
+//
+template <class Key, bool integral = is_integral<Key>::value>
+struct KeyRange {
+	static inline Key lowest() {
+		return Key();
+	}
+	static inline Key highest() {
+		return Key();
+	}
+	static inline void update(Key &, Key &, const Key &) {
+	}
+	static inline Key reduce(const Key &key, const Key &) {
+		return key;
+	}
+	// number of digits needed for the range of keys (more than any plan, so range is never reduced)
+	static inline int digits(const Key &, const Key &, int) {
+		return INT_MAX;
+	}
+};
+
+template <class Key>
+struct KeyRange<Key, true> {
+	static inline Key lowest() {
+		return numeric_limits<Key>::min();
+	}
+	static inline Key highest() {
+		return numeric_limits<Key>::max();
+	}
+	static inline void update(Key &min, Key &max, const Key &key) {
+		min = key < min ? key : min;
+		max = key > max ? key : max;
+	}
+	static inline Key reduce(const Key &key, const Key &offset) {
+		return key - offset;
+	}
+	static inline int digits(const Key &min, const Key &max, int bitCount) {
+		int digits = 0;
+		for (Key range = max - min; range > 0; range = range >> bitCount)
+			digits++;
+		return digits;
+	}
+};
+
+/* Digit of value
+ *
+ * value - value
+ * iterator - number of bits for which value is needed to be moved
+ * bitIntervals - number of bit intervals
+ * offset - key subtracted from the key of value (minimal key, see KeyRange)
+ */
+template<class Ti>
+inline int digitOf(const Ti &value, int iterator, int bitIntervals, const typename RadixTraits<Ti>::Key &offset) {
+	typedef typename RadixTraits<Ti>::Key Key;
+	return (int) ((KeyRange<Key>::reduce(RadixTraits<Ti>::key(value), offset) >> iterator) & (bitIntervals - 1));
+}
+
+// Type of counters (numbers of values, indices, histograms) used with keys of type Tk.
+// Keys hold indices of values, so 32-bit keys need only 32-bit counters
+// and 64-bit counters are used only with wider keys.
+//
+template <class Tk>
+struct RsortCounter {
+	typedef typename conditional<(sizeof(Tk) > sizeof(int)), long long, int>::type type;
+};
+
+/* Checking that N values can be sorted with keys of type Tk
+ * (counters have to hold N and keys indices up to N - 1, they would silently wrap
+ * for longer arrays, so the program is stopped with a message instead)
+ *
+ * N - number of values
+ * inPlace - keys are inverted in place, which needs the highest bit of keys (see invertKeysInPlace)
+ */
+template <class Tk>
+void checkLength(size_t N, bool inPlace = false) {
+	typedef typename RsortCounter<Tk>::type Tc;
+	size_t const highest = inPlace ? (size_t) (numeric_limits<typename make_unsigned<Tk>::type>::max() >> 1)
+			: (size_t) numeric_limits<Tk>::max();
+	if (N > (size_t) numeric_limits<Tc>::max() || (N > 0 && N - 1 > highest)) {
+		fprintf(stderr, "pradsort: %lu values need keys wider than %d bytes\n", (unsigned long) N, (int) sizeof(Tk));
+		abort();
+	}
+}
+
+// Thread data
+template <class Ti, class Tc = int>
 struct RsortData {
         
         // size of data 
         int dataSize;
         
 	// number of values of each bit interval
-	int *bits;
+	Tc *bits;
+
+	// sub-histograms of counting (HISTOGRAM_LANES - 1 of them, see countDigits and countHistograms)
+	Tc *lanes;
+
+	// number of counters in lanes
+	size_t lanesSize;
+
+	// number of values of each bit interval for every digit (digits x bitIntervals)
+	Tc *hist;
+
+	// number of digits in hist
+	int digits;
+
+	// number of counters in hist
+	size_t histSize;
 
 	// array of pointers that are pointing to starting index of input array
 	Ti **start;
@@ -97,25 +583,130 @@ struct RsortData {
 	Ti max;
 
 	// staring index
-	int start_i;
+	Tc start_i;
 
 	// number of values
-	int N;
+	Tc N;
 
 	// Numa node
 	int node;
+
+	// Numa node on which work space lies (see moveScratch)
+	int scratchNode;
+
+	// number of values smaller than their predecessor (counted by countHistograms)
+	Tc descents;
+
+	// minimal and maximal key of values (counted by countHistograms)
+	typename RadixTraits<Ti>::Key minKey;
+	typename RadixTraits<Ti>::Key maxKey;
+
+	// indices of the first MERGE_RUNS of them, where sorted runs begin
+	Tc runs[MERGE_RUNS + 1];
+
+	// thread is bound by binding and its CPU affinity has to be restored by unbinding
+	bool bound;
+#ifdef linux
+
+	// CPU affinity of the thread before binding
+	cpu_set_t affinity;
+#endif
+
+	// write combining buffer (see insertValues)
+	char *buffer;
+
+	// size of write combining buffer in bytes
+	size_t bufferSize;
+
+	// counters of digits of the next pass (see NextDigitCounter)
+	Tc *next;
+
+	// number of counters in next
+	size_t nextSize;
+
+	// work space is placed on the Numa node of the thread (see LOCAL_SCRATCH)
+	bool local;
 	RsortData() {
             	max = 0;
 		start_i = 0;
 		N = 0;
 		node = 0;
+		scratchNode = 0;
+		descents = 0;
+		buffer = NULL;
+		bufferSize = 0;
+		next = NULL;
+		nextSize = 0;
+		bound = false;
+		local = false;
 	}
-        void init(int bitCount){
+        // arrays are allocated on Numa node of the thread when local is set (see scratchAlloc)
+        void init(int bitCount, int node, bool local){
+            this->node = node;
+            scratchNode = node;
+            this->local = local;
             dataSize = 2<<bitCount;
-            bits = new int[dataSize];
-            start = new Ti*[dataSize];
+            setBitCount(bitCount);
+            histSize = (size_t) digits << bitCount;
+            // sub-histograms of all digits are counted together when digits are short enough for sub-histograms
+            lanesSize = (size_t) (HISTOGRAM_LANES - 1) * (bitCount <= HISTOGRAM_LANE_BITS && histSize > ((size_t) 1 << HISTOGRAM_LANE_BITS) ?
+                    histSize : (size_t) 1 << HISTOGRAM_LANE_BITS);
+            bits = (Tc *) scratchAlloc(dataSize * sizeof(Tc), node, local);
+            start = (Ti **) scratchAlloc(dataSize * sizeof(Ti *), node, local);
+            hist = (Tc *) scratchAlloc(histSize * sizeof(Tc), node, local);
+            lanes = (Tc *) scratchAlloc(lanesSize * sizeof(Tc), node, local);
+            buffer = NULL;
+            bufferSize = 0;
+            next = NULL;
+            nextSize = 0;
+            bound = false;
             
         }
+        // growing bits and start arrays for a longer digit (hist is not changed)
+        void reserveBits(int bitCount){
+            if (dataSize >= (2<<bitCount))
+                return;
+            scratchFree(bits, dataSize * sizeof(Tc), local);
+            scratchFree(start, dataSize * sizeof(Ti *), local);
+            dataSize = 2<<bitCount;
+            bits = (Tc *) scratchAlloc(dataSize * sizeof(Tc), node, local);
+            start = (Ti **) scratchAlloc(dataSize * sizeof(Ti *), node, local);
+        }
+        // arrays allocated for bitCount are big enough for every shorter digit
+        void setBitCount(int bitCount){
+            digits = (8 * sizeof(Ti) + bitCount - 1) / bitCount;
+        }
+        void release(){
+            scratchFree(bits, dataSize * sizeof(Tc), local);
+            scratchFree(start, dataSize * sizeof(Ti *), local);
+            scratchFree(hist, histSize * sizeof(Tc), local);
+            scratchFree(lanes, lanesSize * sizeof(Tc), local);
+            scratchFree(next, nextSize * sizeof(Tc), local);
+            scratchFree(buffer, bufferSize, local);
+        }
+        // moving local work space to the node of the thread, when splitValues placed the thread on another node
+        // than the one the work space was allocated for (e.g. a sorter reused with fewer threads)
+        void moveScratch(){
+            if (!local || scratchNode == node)
+                return;
+            scratchBind(bits, dataSize * sizeof(Tc), node);
+            scratchBind(start, dataSize * sizeof(Ti *), node);
+            scratchBind(hist, histSize * sizeof(Tc), node);
+            scratchBind(lanes, lanesSize * sizeof(Tc), node);
+            scratchBind(next, nextSize * sizeof(Tc), node);
+            scratchBind(buffer, bufferSize, node);
+            scratchNode = node;
+        }
+        // counting pages of arrays of the thread, returns the number of them on its Numa node
+        size_t localPages(size_t &pages) const{
+            size_t onNode = pagesOnNode(bits, dataSize * sizeof(Tc), node, pages);
+            onNode += pagesOnNode(start, dataSize * sizeof(Ti *), node, pages);
+            onNode += pagesOnNode(hist, histSize * sizeof(Tc), node, pages);
+            onNode += pagesOnNode(lanes, lanesSize * sizeof(Tc), node, pages);
+            onNode += pagesOnNode(buffer, bufferSize, node, pages);
+            onNode += pagesOnNode(next, nextSize * sizeof(Tc), node, pages);
+            return onNode;
+        }
        
 
 #ifdef linux
@@ -127,6 +718,229 @@ struct RsortData {
 
  
 
+/* Numa nodes and their CPU cores discovered at run time (through libnuma, which reads them from sysfs)
+ *
+ * Only cores of the process CPU affinity mask are used (e.g. in cpusets of containers),
+ * nodes without such cores (or memory only nodes) are skipped. Without Numa support
+ * all cores form one node. Cores of each node are ordered so that hyperthreads (SMT siblings)
+ * come after all physical cores, so threads get their own physical cores first.
+ * Threads are placed on nodes by placeThread.
+ */
+struct NumaTopology {
+
+	// number of nodes with cores
+	int nodes;
+
+	// number of cores of all nodes
+	int cores;
+
+	// numbers of nodes
+	int *node;
+
+	// index in cpu of the first core of each node (nodes + 1 entries)
+	int *firstCore;
+
+	// number of physical cores before each node (nodes + 1 entries)
+	int *firstPhysical;
+
+	// cores of all nodes, node after node (physical cores of node before their hyperthreads)
+	int *cpu;
+
+	// indices in cpu in the order of filling nodes one after another,
+	// first physical cores of all nodes, then their hyperthreads
+	int *order;
+
+	NumaTopology() {
+		nodes = 0;
+		cores = 0;
+		int possible = 1;
+#ifdef linux
+		int maxNode = numa_available() < 0 ? -1 : numa_max_node();
+		possible = maxNode >= 0 ? numa_num_possible_cpus() : (int) sysconf(_SC_NPROCESSORS_CONF);
+		if (possible < CPU_SETSIZE)
+			possible = CPU_SETSIZE;
+		cpu_set_t allowed;
+		CPU_ZERO(&allowed);
+		if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+			for (int c = 0; c < CPU_SETSIZE; c++)
+				CPU_SET(c, &allowed);
+		node = new int[maxNode + 2];
+		firstCore = new int[maxNode + 3];
+		firstPhysical = new int[maxNode + 3];
+		cpu = new int[possible];
+		order = new int[possible];
+		int *level = new int[possible];
+		if (maxNode >= 0) {
+			struct bitmask *cpus = numa_allocate_cpumask();
+			for (int n = 0; n <= maxNode; n++) {
+				firstCore[nodes] = cores;
+				if (numa_node_to_cpus(n, cpus) < 0)
+					continue;
+				for (int c = 0; c < possible && c < CPU_SETSIZE; c++)
+					if (numa_bitmask_isbitset(cpus, c) && CPU_ISSET(c, &allowed))
+						cpu[cores++] = c;
+				if (cores > firstCore[nodes])
+					node[nodes++] = n;
+			}
+			numa_free_cpumask(cpus);
+		}
+		// one node with every core
+		if (cores == 0) {
+			nodes = 1;
+			node[0] = 0;
+			firstCore[0] = 0;
+			for (int c = 0; c < CPU_SETSIZE; c++)
+				if (CPU_ISSET(c, &allowed))
+					cpu[cores++] = c;
+		}
+		if (cores == 0)
+			cpu[cores++] = 0;
+		firstCore[nodes] = cores;
+
+		// SMT level of each core (number of its siblings before it)
+		int *coreId = new int[cores];
+		for (int i = 0; i < cores; i++) {
+			coreId[i] = smtCore(cpu[i]);
+			level[i] = 0;
+			for (int k = 0; k < i; k++)
+				if (coreId[i] >= 0 && coreId[k] == coreId[i])
+					level[i]++;
+		}
+		delete[] coreId;
+#endif
+#ifdef _WIN32
+		SYSTEM_INFO sInfo;
+		GetSystemInfo(&sInfo);
+		possible = sInfo.dwNumberOfProcessors;
+		if (possible < 1)
+			possible = 1;
+		node = new int[1];
+		firstCore = new int[2];
+		firstPhysical = new int[2];
+		cpu = new int[possible];
+		order = new int[possible];
+		int *level = new int[possible];
+		nodes = 1;
+		node[0] = 0;
+		firstCore[0] = 0;
+		for (cores = 0; cores < possible; cores++) {
+			cpu[cores] = cores;
+			level[cores] = 0;
+		}
+		firstCore[1] = cores;
+#endif
+		orderCores(level);
+		delete[] level;
+	}
+	~NumaTopology() {
+		delete[] node;
+		delete[] firstCore;
+		delete[] firstPhysical;
+		delete[] cpu;
+		delete[] order;
+	}
+
+	/* Ordering physical cores of each node before their hyperthreads (stable sorting by SMT level)
+	 * and determining the order of filling nodes
+	 *
+	 * level - SMT level of each core (number of its siblings before it)
+	 */
+	void orderCores(const int *level) {
+		int *sorted = new int[cores];
+		int *sortedLevel = new int[cores];
+		int levels = 0;
+		firstPhysical[0] = 0;
+		for (int n = 0; n < nodes; n++) {
+			int position = firstCore[n];
+			for (int l = 0; position < firstCore[n + 1]; l++)
+				for (int i = firstCore[n]; i < firstCore[n + 1]; i++)
+					if (level[i] == l) {
+						sorted[position] = cpu[i];
+						sortedLevel[position++] = l;
+						if (l + 1 > levels)
+							levels = l + 1;
+					}
+			firstPhysical[n + 1] = firstPhysical[n];
+			for (int i = firstCore[n]; i < firstCore[n + 1]; i++)
+				if (level[i] == 0)
+					firstPhysical[n + 1]++;
+		}
+		int filled = 0;
+		for (int l = 0; l < levels; l++)
+			for (int n = 0; n < nodes; n++)
+				for (int i = firstCore[n]; i < firstCore[n + 1]; i++)
+					if (sortedLevel[i] == l)
+						order[filled++] = i;
+		for (int i = 0; i < cores; i++)
+			cpu[i] = sorted[i];
+		delete[] sorted;
+		delete[] sortedLevel;
+	}
+
+	/* Physical core of CPU (unique number of its package and core read from sysfs, -1 if unknown)
+	 *
+	 * c - CPU core
+	 */
+	static int smtCore(int c) {
+		int core = -1;
+#ifdef linux
+		int package = 0;
+		char path[96];
+		sprintf(path, "/sys/devices/system/cpu/cpu%d/topology/core_id", c);
+		FILE *file = fopen(path, "r");
+		if (file == NULL)
+			return -1;
+		if (fscanf(file, "%d", &core) != 1)
+			core = -1;
+		fclose(file);
+		sprintf(path, "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", c);
+		file = fopen(path, "r");
+		if (file != NULL) {
+			if (fscanf(file, "%d", &package) != 1)
+				package = 0;
+			fclose(file);
+		}
+		if (core >= 0)
+			core += package << 16;
+#endif
+		return core;
+	}
+
+	/* Placing thread on Numa node and CPU core
+	 *
+	 * id - thread number
+	 * t - number of threads
+	 * nodeBind - binding threads to Numa nodes (see NODE_BIND)
+	 * threadNode - output, number of node
+	 * threadCpu - output, CPU core
+	 */
+	void placeThread(int id, int t, int nodeBind, int &threadNode, int &threadCpu) const {
+		int n = 0;
+		int core;
+		if (nodeBind == 1) {
+			// node n gets threads from t * firstPhysical[n] / physical to t * firstPhysical[n+1] / physical
+			long long physical = firstPhysical[nodes];
+			while (n + 1 < nodes && id >= (int) (t * firstPhysical[n + 1] / physical))
+				n++;
+			int first = (int) (t * firstPhysical[n] / physical);
+			core = firstCore[n] + (id - first) % (firstCore[n + 1] - firstCore[n]);
+		} else {
+			core = order[id % cores];
+			while (n + 1 < nodes && core >= firstCore[n + 1])
+				n++;
+		}
+		threadNode = node[n];
+		threadCpu = cpu[core];
+	}
+};
+
+/* Numa topology of the machine (discovered once)
+ */
+inline const NumaTopology &numaTopology() {
+	static NumaTopology topology;
+	return topology;
+}
+
 /* Calculating starting indices and number of values for each thread
  *
  * t - number of threads
@@ -135,8 +949,8 @@ struct RsortData {
  * first - first element of array
  * page_size = page size
  */
-template<class Ti>
-void set_index(int t, int N, RsortData<Ti> * datas, bool first, int page_size) {
+template<class Ti, class Tc>
+void set_index(int t, Tc N, RsortData<Ti,Tc> * datas, bool first, int page_size) {
 	if (t == 1) {
 		(datas)->N = N * page_size;
 		if (first)
@@ -153,533 +967,3170 @@ void set_index(int t, int N, RsortData<Ti> * datas, bool first, int page_size) {
 	}
 }
 
-/* Binding threads to Numa nodes and CPU cores
- * First touch temporary array
+/* Creating threads data
+ * (with local work space arrays of each thread are allocated by the thread itself on its Numa node,
+ * otherwise by the calling thread)
+ *
+ * t - number of threads
+ * bitCount - number of sorted bits in one iteration
+ * nodeBind - binding threads to Numa nodes (see NODE_BIND)
+ * local - work space of threads is placed on their Numa nodes (see LOCAL_SCRATCH)
+ */
+template<class Ti, class Tc>
+RsortData<Ti,Tc> * createThreadsData(int t, int bitCount, int nodeBind, bool local) {
+	RsortData<Ti,Tc> * datas = (RsortData<Ti,Tc> *) alignedAlloc(t * sizeof(RsortData<Ti,Tc>));
+#pragma omp parallel num_threads(t) if(local)
+	for(int i=omp_get_thread_num();i<t;i+=omp_get_num_threads()){
+            int node, cpu;
+            numaTopology().placeThread(i, t, nodeBind, node, cpu);
+            datas[i].N=0;
+            datas[i].init(bitCount, node, local);
+            
+        }
+	return datas;
+}
+
+/* Splitting values between threads
+ * (with NODE_BIND 1 threads of one Numa node are numbered consecutively, so each node gets
+ * one part of arrays in proportion to the number of its threads)
  *
  * t - number of threads
  * N - number of values
  * datas - threads data
- * src - input array
  * page_size - page size
+ * nodeBind - binding threads to Numa nodes (see NODE_BIND)
  */
-template<class Ti>
-void binding(int t,  int N, RsortData<Ti> *datas, Ti *src, int page_size) {
-#pragma omp parallel
-	{
-		int id = omp_get_thread_num();
-		RsortData<Ti> mydata = datas[id];
-#if CPU_BIND==1
-#ifdef linux
-		cpu_set_t set;
-		CPU_ZERO(&set);
-		CPU_SET(omp_get_thread_num(), &set);
-		pid_t tid = (pid_t) syscall(SYS_gettid);
-		sched_setaffinity(tid, sizeof(set), &set);
-#endif
-#ifdef _WIN32
-		HANDLE process = GetCurrentProcess();
-		DWORD_PTR mask = 1 << omp_get_thread_num();
-		SetProcessAffinityMask(process, mask);
+template<class Ti, class Tc>
+void splitValues(int t, Tc N, RsortData<Ti,Tc> *datas, int page_size, int nodeBind) {
+	set_index<Ti,Tc>(t, N / page_size, datas, true, page_size);
+	datas[t - 1].N += N - ((N / page_size) * page_size);
+	for (int id = 0; id < t; id++) {
+		int cpu;
+		numaTopology().placeThread(id, t, nodeBind, datas[id].node, cpu);
+	}
+}
 
-#endif
-#endif
+/* Placing parts of array on Numa nodes of threads which use them (Policy::numa 2)
+ *
+ * t - number of threads
+ * datas - threads data
+ * array - array
+ * size - size of one element in bytes
+ */
+template<class Ti, class Tc>
+void placeOnNodes(int t, RsortData<Ti,Tc> *datas, void *array, size_t size) {
 #ifdef linux
-#if NODE_BIND ==1
-		if (id < omp_get_num_threads() / 2)
-		mydata.node = 0;
-		else
-		mydata.node = 1;
-		numa_run_on_node(mydata.node);
-#elif NODE_BIND==2
-		numa_run_on_node(id>=8);
+	uintptr_t const page = (uintptr_t) numa_pagesize();
+	char *base = (char *) array;
+	for (int first = 0, last; first < t; first = last + 1) {
+		for (last = first; last + 1 < t && datas[last + 1].node == datas[first].node; last++)
+			;
+		// page shared with the previous part goes to this node
+		char *begin = (char *) ((uintptr_t) (base + datas[first].start_i * size) & ~(page - 1));
+		char *end = base + (datas[last].start_i + datas[last].N) * size;
+		if (end > begin)
+			numa_tonode_memory(begin, end - begin, datas[first].node);
+	}
 #endif
+}
+
+/* Releasing threads data created by createThreadsData
+ *
+ * t - number of threads
+ * datas - threads data
+ */
+template<class Ti, class Tc>
+void releaseThreadsData(int t, RsortData<Ti,Tc> *datas) {
+	for(int i=0;i<t;i++)
+            datas[i].release();
+	alignedFree(datas);
+}
+
+/* Page size in number of values (1 if data is not split in pages)
+ *
+ * pageSizeIncluded - data is split in pages (see PAGE_SIZE_INCLUDED)
+ */
+template<class Ti>
+int pageSize(bool pageSizeIncluded) {
+	int page_size = 1;
+	if (pageSizeIncluded) {
+#ifdef linux
+		page_size= numa_pagesize()/sizeof(Ti);
 #endif
-		Ti * start = src + mydata.start_i;
-#if FIRST_TOUCH>0
-#if FIRST_TOUCH==1
-		for (int i = 0; i < mydata.N; i++)
-#elif FIRST_TOUCH==2
+#ifdef _WIN32
+
+		SYSTEM_INFO sInfo;
+		GetSystemInfo(&sInfo);
+		page_size = sInfo.dwPageSize / sizeof(Ti);
+#endif
+	}
+	return page_size > 0 ? page_size : 1;
+}
+
+/* Binding threads to Numa nodes and CPU cores
+ * First touch temporary array
+ *
+ * t - number of threads
+ * datas - threads data
+ * src - input array (NULL if there is no array to touch)
+ * policy - placement policy
+ */
+template<class Ti, class Tc>
+void binding(int t, RsortData<Ti,Tc> *datas, Ti *src, const Policy &policy) {
+#pragma omp parallel num_threads(t)
+	{
+		int id = omp_get_thread_num();
+		RsortData<Ti,Tc> mydata = datas[id];
 #ifdef linux
-		for (int i = 0; i < mydata.N; i += numa_pagesize()/sizeof(int))
+		int node, cpu;
+		numaTopology().placeThread(id, omp_get_num_threads(), policy.nodeBind, node, cpu);
+		// affinity is saved only once, binding may be called again before unbinding
+		if ((policy.cpuBind == 1 || policy.nodeBind > 0) && !datas[id].bound)
+			datas[id].bound = sched_getaffinity(0, sizeof(cpu_set_t), &datas[id].affinity) == 0;
+		if (policy.cpuBind == 1) {
+			// core of the thread lies in its node
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			CPU_SET(cpu, &set);
+			pid_t tid = (pid_t) syscall(SYS_gettid);
+			sched_setaffinity(tid, sizeof(set), &set);
+		} else if (policy.nodeBind > 0)
+			numa_run_on_node(node);
 #endif
 #ifdef _WIN32
-		SYSTEM_INFO systemInfo;
-		GetSystemInfo(&systemInfo);
-		for (int i = 0; i < mydata.N; i += systemInfo.dwPageSize / sizeof(int))
+		if (policy.cpuBind == 1) {
+			HANDLE process = GetCurrentProcess();
+			DWORD_PTR mask = 1 << omp_get_thread_num();
+			SetProcessAffinityMask(process, mask);
+		}
+#endif
+		Ti * start = src + mydata.start_i;
+		Tc touched = (src != NULL && policy.firstTouch > 0) ? mydata.N : 0;
+		Tc step = 1;
+		if (policy.firstTouch == 2) {
+#ifdef linux
+			step = numa_pagesize() / sizeof(Ti);
 #endif
+#ifdef _WIN32
+			SYSTEM_INFO systemInfo;
+			GetSystemInfo(&systemInfo);
+			step = systemInfo.dwPageSize / sizeof(Ti);
 #endif
+			if (step < 1)
+				step = 1;
+		}
+		for (Tc i = 0; i < touched; i += step)
 		{
 			*(start + i) = 0;
 		}
-#endif
 	}
 }
 
-/* Counting max value
+/* Restoring CPU affinity of threads bound by binding
  *
+ * t - number of threads
  * datas - threads data
- * src - input array
  */
-template<class Ti>
-Ti countMax(RsortData<Ti> *datas, Ti *src) {
-
-	Ti max = 0;
-#pragma omp parallel
+template<class Ti, class Tc>
+void unbinding(int t, RsortData<Ti,Tc> *datas) {
+#pragma omp parallel num_threads(t)
 	{
 		int id = omp_get_thread_num();
-		Ti my_max = 0;
-		RsortData<Ti> mydata = datas[id];
-		Ti *pointer = src + mydata.start_i;
-		for (int i = 0; i < mydata.N; i++)
-			my_max |= (*pointer++);
-
-#pragma omp critical
-			max |= my_max;
+		if (datas[id].bound) {
+#ifdef linux
+			pid_t tid = (pid_t) syscall(SYS_gettid);
+			sched_setaffinity(tid, sizeof(cpu_set_t), &datas[id].affinity);
+#endif
+			datas[id].bound = false;
+		}
+	}
+}
 
-		datas[id] = mydata;
+// Digit of keys sorted in one pass: width bits from bit shift,
+// its histogram of 2^width bit intervals begins at index row of histograms.
+//
+struct Digit {
+	int shift;
+	int width;
+	int row;
+};
 
+/* Digits of bitCount bits covering whole keys (the highest digit takes the remaining bits),
+ * returns the number of digits
+ *
+ * digits - output, digits
+ * bitCount - number of bits in one digit
+ */
+template<class Ti>
+int uniformDigits(Digit *digits, int bitCount) {
+	int const keyBits = 8 * sizeof(Ti);
+	int count = 0;
+	for (int shift = 0; shift < keyBits; shift += bitCount, count++) {
+		digits[count].shift = shift;
+		digits[count].width = keyBits - shift < bitCount ? keyBits - shift : bitCount;
+		digits[count].row = count > 0 ? digits[count - 1].row + (1 << digits[count - 1].width) : 0;
 	}
-	return max;
+	return count;
 }
 
-/* Counting the number of bits of each bit interval
+/* Adding histograms of all threads into the global histogram
+ *
+ * Each thread adds its own block of bit intervals (whole cache lines of counters) of all threads,
+ * so threads add their blocks at the same time and no counter is written by two threads.
+ * Run by every thread of the parallel region of sorting after histograms of all threads are counted.
  *
  * datas - threads data
- * src - input array
- * start_higher - array of indices from which each bit interval begins
- * iterator - number of bits for which value is needed to be moved
- * bitIntervals - number of bit intervals
+ * histogram - histogram of each thread (RsortData::hist or RsortData::bits)
+ * sum - output, global histogram
+ * size - number of counters of histograms
  */
-template<class Ti>
-void countBitInterval(RsortData<Ti> *datas, Ti *src, int *start_higher, int iterator, int bitIntervals) {
-#pragma omp parallel
-	{
-#pragma omp for
-		for (int i = 0; i < bitIntervals - 1; i++)
-			start_higher[i] = 0;
+template<class Ti, class Tc>
+void addHistograms(const RsortData<Ti,Tc> *datas, Tc *RsortData<Ti,Tc>::*histogram, Tc *sum, int size) {
+	int const id = omp_get_thread_num();
+	int const t = omp_get_num_threads();
+	int const line = CACHE_LINE / sizeof(Tc);
+	int const lines = (size + line - 1) / line;
+	int const first = (int) ((long long) lines * id / t) * line;
+	int last = (int) ((long long) lines * (id + 1) / t) * line;
+	if (last > size)
+		last = size;
+	if (first >= last)
+		return;
 
-		int id = omp_get_thread_num();
-		RsortData<Ti> mydata = datas[id];
+	const Tc *counts = datas[0].*histogram;
+	for (int i = first; i < last; i++)
+		sum[i] = counts[i];
+	for (int k = 1; k < t; k++) {
+		counts = datas[k].*histogram;
+		for (int i = first; i < last; i++)
+			sum[i] += counts[i];
+	}
+}
 
-		for (int i = 0; i < bitIntervals; i++)
-			mydata.bits[i] = 0;
+/* Number of low bits of a digit which differ between values of the whole array
+ * (0 if the digit takes one value, passes of constant digits would only move values to the other array,
+ * and high bits which are the same in all values need no bit intervals)
+ *
+ * hist - histogram of the digit
+ * width - number of bits of the digit
+ * lowest - output, lowest bit interval which is not empty
+ */
+template<class Tc>
+inline int digitWidth(const Tc *hist, int width, int &lowest) {
+	lowest = -1;
+	int highest = 0;
+	for (int i = 0; i < (1 << width); i++)
+		if (hist[i] > 0) {
+			if (lowest < 0)
+				lowest = i;
+			highest = i;
+		}
+	// bits above the highest bit in which the lowest and the highest bit interval differ are the same in all of them
+	int bits = 0;
+	while (lowest >= 0 && ((lowest ^ highest) >> bits) > 0)
+		bits++;
+	return bits;
+}
 
-		Ti *pointer = src + mydata.start_i;
-		for (int z = 0; z < mydata.N; z++) {
+#if X86_DISPATCH
+// AVX-512 intrinsics of GCC 12 leave parts of results undefined on purpose, which is reported as uninitialized
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
 
-			mydata.bits[(*(pointer++)) >> (iterator) & (bitIntervals - 1)]++;
-		}
+/* Number of set bits of each 32-bit element (elements below 2^16)
+ */
+__attribute__((target("avx512f"))) inline __m512i popcount16(__m512i x) {
+	x = _mm512_sub_epi32(x, _mm512_and_si512(_mm512_srli_epi32(x, 1), _mm512_set1_epi32(0x5555)));
+	x = _mm512_add_epi32(_mm512_and_si512(x, _mm512_set1_epi32(0x3333)),
+			_mm512_and_si512(_mm512_srli_epi32(x, 2), _mm512_set1_epi32(0x3333)));
+	x = _mm512_and_si512(_mm512_add_epi32(x, _mm512_srli_epi32(x, 4)), _mm512_set1_epi32(0x0f0f));
+	return _mm512_and_si512(_mm512_add_epi32(x, _mm512_srli_epi32(x, 8)), _mm512_set1_epi32(0x1f));
+}
 
-#pragma omp critical
-		for (int i = 0; i < bitIntervals; i++)
-			start_higher[i] += mydata.bits[i];
+/* Counting 16 digits with AVX-512
+ *
+ * Counters of digits are gathered, increased and scattered back. Equal digits of the vector
+ * are found by conflict detection: each of them adds the number of its predecessors plus one,
+ * and the last of them, which is scattered last, holds the whole count.
+ *
+ * digit - digits
+ * bits - 32-bit counters of bit intervals
+ */
+__attribute__((target("avx512f,avx512cd"))) inline void countVector(__m512i digit, void *bits) {
+	__m512i earlier = popcount16(_mm512_conflict_epi32(digit));
+	__m512i count = _mm512_i32gather_epi32(digit, bits, 4);
+	count = _mm512_add_epi32(count, _mm512_add_epi32(earlier, _mm512_set1_epi32(1)));
+	_mm512_i32scatter_epi32(bits, digit, count, 4);
+}
 
-		datas[id] = mydata;
+/* Counting digits of 32-bit keys with AVX-512 (returns the number of counted values, a multiple of 16)
+ *
+ * src - keys of values are (src ^ flip) - offset
+ * N - number of values
+ * bits - 32-bit counters of bit intervals
+ * iterator - number of bits for which value is needed to be moved
+ * mask - bitIntervals - 1
+ */
+__attribute__((target("avx512f,avx512cd"))) inline size_t countConflicts(const uint32_t *src, size_t N, void *bits,
+		int iterator, uint32_t mask, uint32_t flip, uint32_t offset) {
+	__m512i const flips = _mm512_set1_epi32((int) flip);
+	__m512i const offsets = _mm512_set1_epi32((int) offset);
+	__m512i const masks = _mm512_set1_epi32((int) mask);
+	__m128i const shift = _mm_cvtsi32_si128(iterator);
+	size_t i = 0;
+	for (; i + 16 <= N; i += 16) {
+		__m512i key = _mm512_sub_epi32(_mm512_xor_si512(_mm512_loadu_si512(src + i), flips), offsets);
+		countVector(_mm512_and_si512(_mm512_srl_epi32(key, shift), masks), bits);
 	}
-#pragma omp barrier
+	return i;
 }
 
-/* Calculating starting indices for each bits interval
- *
- * t- number of threads
- * datas - threads data
- * start_higher - array of indices from which each bits interval begins
- * start_index - starting index
- * bitIntervals - number of bit intervals
+/* Counting digits of 64-bit keys with AVX-512 (returns the number of counted values, a multiple of 16)
+ * (see countConflicts of 32-bit keys, digits of two vectors of keys are counted together)
  */
-template<class Ti>
-void calculateStartingIndices(int t, RsortData<Ti> *datas, int *start_higher,
-		int start_index, int bitIntervals) {
-        int log2t = (int)( 0.2 + log(t - 1) / log(2) ); // 0.2 - rounding error elimination
-	for (int d = 0; d < log2t; d++) {
-#pragma omp parallel for
-		for (int i = t - 1; i >= (1 << d); i -= 1 << (d + 1)) {
-			for (int j = 0; j < bitIntervals; j++)
-				datas[i].bits[j] += datas[i - (1 << d)].bits[j];
-		}
-	}
-	datas[t - 1].bits[0] = start_index;
-	for (int i = 1; i < bitIntervals; i++)
-		datas[t - 1].bits[i] = datas[t - 1].bits[i - 1] + start_higher[i - 1];
-
-	for (int d = log2t; d >= 0; d--) {
-#pragma omp parallel for
-		for (int i = t - 1; i >= (1 << (d)); i -= 1 << (d + 1)) {
-			for (int j = 0; j < bitIntervals; j++) {
-				datas[i - (1 << (d))].bits[j] ^= datas[i].bits[j];
-				datas[i].bits[j] ^= datas[i - (1 << (d))].bits[j];
-				datas[i - (1 << (d))].bits[j] ^= datas[i].bits[j];
-				datas[i].bits[j] += datas[i - (1 << (d))].bits[j];
-			}
-		}
+__attribute__((target("avx512f,avx512cd"))) inline size_t countConflicts(const uint64_t *src, size_t N, void *bits,
+		int iterator, uint64_t mask, uint64_t flip, uint64_t offset) {
+	__m512i const flips = _mm512_set1_epi64((long long) flip);
+	__m512i const offsets = _mm512_set1_epi64((long long) offset);
+	__m512i const masks = _mm512_set1_epi64((long long) mask);
+	__m128i const shift = _mm_cvtsi32_si128(iterator);
+	size_t i = 0;
+	for (; i + 16 <= N; i += 16) {
+		__m512i low = _mm512_sub_epi64(_mm512_xor_si512(_mm512_loadu_si512(src + i), flips), offsets);
+		__m512i high = _mm512_sub_epi64(_mm512_xor_si512(_mm512_loadu_si512(src + i + 8), flips), offsets);
+		low = _mm512_and_si512(_mm512_srl_epi64(low, shift), masks);
+		high = _mm512_and_si512(_mm512_srl_epi64(high, shift), masks);
+		countVector(_mm512_inserti64x4(_mm512_castsi256_si512(_mm512_cvtepi64_epi32(low)), _mm512_cvtepi64_epi32(high), 1), bits);
 	}
+	return i;
 }
+#pragma GCC diagnostic pop
 
-/* Inserting values into output array
+/* Counting digits of 32-bit keys in 4 sub-histograms with AVX2 (returns the number of counted values, a multiple of 8)
+ * (digits of 8 keys are computed in one vector, then counted in sub-histograms in turn)
  *
- * datas - threads data
- * src - input array
- * dest - output array
+ * src - keys of values are (src ^ flip) - offset
+ * N - number of values
+ * lane - 4 sub-histograms
  * iterator - number of bits for which value is needed to be moved
- * bitIntervals - number of bit intervals
+ * mask - bitIntervals - 1
  */
-template<class Ti,class Tk>
-void insertValues(RsortData<Ti> *datas, Ti *src, Ti *dest,Tk *src_key,Tk *dest_key, int iterator,int N,int t, int bitIntervals) {
-#ifdef linux
-#if NUMA==2
-	numa_interleave_memory(dest,N*sizeof(Ti),numa_all_nodes_ptr);
-#endif
+template<class Tc>
+__attribute__((target("avx2"))) size_t countLanesAvx2(const uint32_t *src, size_t N, Tc **lane,
+		int iterator, uint32_t mask, uint32_t flip, uint32_t offset) {
+	__m256i const flips = _mm256_set1_epi32((int) flip);
+	__m256i const offsets = _mm256_set1_epi32((int) offset);
+	__m256i const masks = _mm256_set1_epi32((int) mask);
+	__m128i const shift = _mm_cvtsi32_si128(iterator);
+	int digit[8] __attribute__((aligned(32)));
+	size_t i = 0;
+	for (; i + 8 <= N; i += 8) {
+		__m256i key = _mm256_sub_epi32(_mm256_xor_si256(_mm256_loadu_si256((const __m256i *) (src + i)), flips), offsets);
+		_mm256_store_si256((__m256i *) digit, _mm256_and_si256(_mm256_srl_epi32(key, shift), masks));
+		for (int d = 0; d < 8; d++)
+			lane[d & 3][digit[d]]++;
+	}
+	return i;
+}
+
 #endif
-#pragma omp parallel
-	{
-		int id = omp_get_thread_num();
-		RsortData<Ti> mydata = datas[id];
-		for (int i = 0; i < bitIntervals; i++){
-			mydata.start[i] = dest + mydata.bits[i];
-		}
 
-		Ti *pointer = src + mydata.start_i;
-		Tk *key_pointer = src_key + mydata.start_i;
-		for (int i = 0; i < mydata.N; i++) {
-			int index = (*pointer) >> (iterator) & (bitIntervals - 1);
-			*(dest_key +mydata.bits[index]++) = *(key_pointer++);
+// Counting kernels of instruction sets for integers of 32 and 64 bits (see countLanes and countSingle),
+// other values are left to portable code (kernels return 0 counted values).
+//
+template <class Ti, class Tc, class Enable = void>
+struct CountKernels {
+	static inline size_t conflicts(const Ti *, size_t, Tc *, int, int, const typename RadixTraits<Ti>::Key &) {
+		return 0;
+	}
+	static inline size_t lanes(const Ti *, size_t, Tc **, int, int, const typename RadixTraits<Ti>::Key &) {
+		return 0;
+	}
+};
 
-			*(mydata.start[index]++) =*(pointer++);
-		}
+#if X86_DISPATCH
+template <class Ti, class Tc>
+struct CountKernels<Ti, Tc, typename enable_if<is_integral<Ti>::value && (sizeof(Ti) == 4 || sizeof(Ti) == 8)>::type> {
+	typedef typename RadixTraits<Ti>::Key Key;
+	typedef typename conditional<sizeof(Ti) == 4, uint32_t, uint64_t>::type Word;
+
+	// keys of integers differ from values only in the sign bit of signed integers
+	static inline size_t conflicts(const Ti *src, size_t N, Tc *bits, int iterator, int bitIntervals, const Key &offset) {
+		if (sizeof(Tc) != 4 || !cpuFeatures().avx512)
+			return 0;
+		return countConflicts((const Word *) src, N, bits, iterator, (Word) (bitIntervals - 1),
+				(Word) RadixTraits<Ti>::key(0), (Word) offset);
+	}
+	// digits of 64-bit keys are counted in sub-histograms as fast by portable code
+	static inline size_t lanes(const Ti *src, size_t N, Tc **lane, int iterator, int bitIntervals, const Key &offset) {
+		if (sizeof(Ti) != 4 || !cpuFeatures().avx2)
+			return 0;
+		return countLanesAvx2((const uint32_t *) src, N, lane, iterator, (uint32_t) (bitIntervals - 1),
+				(uint32_t) RadixTraits<Ti>::key(0), (uint32_t) offset);
+	}
+};
+#endif
 
+/* Counting digits of values in HISTOGRAM_LANES sub-histograms with the best kernel of the CPU
+ * (digits of 32-bit integers are computed with AVX2 when possible, sub-histograms are neither zeroed nor added,
+ * see countDigits)
+ *
+ * src - values
+ * N - number of values
+ * lane - sub-histograms
+ * iterator - number of bits for which value is needed to be moved
+ * bitIntervals - number of bit intervals
+ * offset - key subtracted from keys of values
+ */
+template<class Ti, class Tc>
+void countLanes(const Ti *src, Tc N, Tc **lane, int iterator, int bitIntervals, const typename RadixTraits<Ti>::Key &offset) {
+	Tc z = 0;
+	if (HISTOGRAM_LANES == 4)
+		z += (Tc) CountKernels<Ti,Tc>::lanes(src, (size_t) N, lane, iterator, bitIntervals, offset);
+	for (; z + HISTOGRAM_LANES <= N; z += HISTOGRAM_LANES)
+		for (int l = 0; l < HISTOGRAM_LANES; l++)
+			lane[l][digitOf(src[z + l], iterator, bitIntervals, offset)]++;
+	for (; z < N; z++)
+		lane[0][digitOf(src[z], iterator, bitIntervals, offset)]++;
+}
 
+/* Counting digits of values in one histogram with the best kernel of the CPU
+ * (integers with conflict detection of AVX-512, 32-bit counters only, see countDigits)
+ *
+ * bits - number of values of each bit interval (not zeroed)
+ * other parameters - see countLanes
+ */
+template<class Ti, class Tc>
+void countSingle(const Ti *src, Tc N, Tc *bits, int iterator, int bitIntervals, const typename RadixTraits<Ti>::Key &offset) {
+	Tc z = (Tc) CountKernels<Ti,Tc>::conflicts(src, (size_t) N, bits, iterator, bitIntervals, offset);
+	for (; z < N; z++)
+		bits[digitOf(src[z], iterator, bitIntervals, offset)]++;
+}
 
-#pragma omp barrier
-		;
+/* Counting digits of values of one thread with the best kernel of the CPU
+ *
+ * Consecutive values are counted in HISTOGRAM_LANES sub-histograms, so an increment does not wait
+ * for the previous increment of the same counter when digits repeat (see countLanes).
+ * Sub-histograms are added to bits at the end.
+ * Sub-histograms of longer digits would not fit in caches, so their digits are counted in one histogram
+ * (see countSingle).
+ *
+ * src - values
+ * N - number of values
+ * bits - number of values of each bit interval (zeroed)
+ * lanes - work space of (HISTOGRAM_LANES - 1) x 2^HISTOGRAM_LANE_BITS counters
+ * iterator - number of bits for which value is needed to be moved
+ * bitIntervals - number of bit intervals
+ * offset - key subtracted from keys of values
+ */
+template<class Ti, class Tc>
+void countDigits(const Ti *src, Tc N, Tc *bits, Tc *lanes, int iterator, int bitIntervals,
+		const typename RadixTraits<Ti>::Key &offset) {
+	if (HISTOGRAM_LANES > 1 && bitIntervals <= (1 << HISTOGRAM_LANE_BITS) && N >= (Tc) bitIntervals) {
+		Tc *lane[HISTOGRAM_LANES > 4 ? HISTOGRAM_LANES : 4];
+		lane[0] = bits;
+		for (int l = 1; l < HISTOGRAM_LANES; l++) {
+			lane[l] = lanes + (l - 1) * bitIntervals;
+			for (int i = 0; i < bitIntervals; i++)
+				lane[l][i] = 0;
+		}
+		countLanes(src, N, lane, iterator, bitIntervals, offset);
+		for (int l = 1; l < HISTOGRAM_LANES; l++)
+			for (int i = 0; i < bitIntervals; i++)
+				bits[i] += lane[l][i];
+		return;
 	}
-#ifdef linux
-#if NUMA==2
-#if NODE_BIND==0
-	numa_tonode_memory(dest,N*sizeof(Ti),0);
-
-#elif NODE_BIND==1
-	numa_tonode_memory(dest,N*sizeof(Ti),1);
-	numa_tonode_memory(dest,sizeof(Ti)*datas[t/2+1].start_i,0);
-#elif NODE_BIND==2
-	if(t<=8){
-		numa_tonode_memory(dest,N*sizeof(Ti),0);}
-	else
-		numa_tonode_memory(dest,N*sizeof(Ti),1);
-		numa_tonode_memory(dest,sizeof(Ti)*datas[8].start_i,0);
-#endif
-#endif
-#endif
+	countSingle(src, N, bits, iterator, bitIntervals, offset);
 }
 
-/* Copy array
+/* Counting the number of values of each bit interval for every digit
+ * in a single read of the input array
  *
- * datas - thread data
- * dest - output array
+ * Digits short enough for sub-histograms (see countDigits) are counted one digit after another in blocks
+ * of values, which stay in cache between the digits, longer digits are counted all together for each value.
+ *
+ * Values smaller than their predecessor (descents) are counted in the same read, so presorted
+ * arrays are recognized: without descents values are sorted, when every value is a descent
+ * they are sorted in reverse, and descents begin sorted runs otherwise (each thread keeps
+ * indices of its first MERGE_RUNS descents).
+ *
+ * Like other phases of sorting, it is run by every thread of the parallel region of sorting (see RSB),
+ * outputs are shared by threads and they are known to all threads when it returns. Histograms
+ * of threads are added by all threads (see addHistograms), minimal and maximal keys and descents
+ * of threads by one thread.
+ *
+ * datas - threads data
+ * mydata - data of the calling thread
  * src - input array
+ * hist - global histograms of every digit (2^width bit intervals of each digit, one after another)
+ * digits - counted digits
+ * count - number of digits
+ * offset - key subtracted from keys of values
+ * min, max - output, minimal and maximal key of values (integer keys only)
+ * descents - output, number of values smaller than their predecessor
  */
-template<class Ti>
-void copyArray(RsortData<Ti> *datas,Ti * dest, Ti *src) {
-#pragma omp parallel
-	{
-		int id = omp_get_thread_num();
-		RsortData<Ti> mydata = datas[id];
+template<class Ti, class Tc>
+void countHistograms(RsortData<Ti,Tc> *datas, RsortData<Ti,Tc> &mydata, const Ti *src, Tc *hist, const Digit *digits, int count,
+		const typename RadixTraits<Ti>::Key &offset, typename RadixTraits<Ti>::Key &min, typename RadixTraits<Ti>::Key &max,
+		Tc &descents) {
+	typedef typename RadixTraits<Ti>::Key Key;
 
-		Ti *source = src + mydata.start_i;
+	int const size = digits[count - 1].row + (1 << digits[count - 1].width);
+	int const id = omp_get_thread_num();
 
-		Ti *destination = dest + mydata.start_i;
-		for (int i = 0; i < mydata.N; i++){
-			*(destination++) = *source++;
+	for (int i = 0; i < size; i++)
+		mydata.hist[i] = 0;
+
+	// digits are copied so that the loop reads them from the stack
+	int shift[8 * sizeof(Ti)];
+	int intervals[8 * sizeof(Ti)];
+	Tc *digit_hist[8 * sizeof(Ti)];
+	for (int d = 0; d < count; d++) {
+		shift[d] = digits[d].shift;
+		intervals[d] = 1 << digits[d].width;
+		digit_hist[d] = mydata.hist + digits[d].row;
+	}
+
+	// every digit is counted in its own sub-histograms (see countDigits), when all of them fit in the work space
+	// and the thread has enough values to repay their adding
+	bool lanes = HISTOGRAM_LANES > 1 && (size_t) (HISTOGRAM_LANES - 1) * size <= mydata.lanesSize && mydata.N >= (Tc) size;
+	for (int d = 0; d < count; d++)
+		lanes = lanes && digits[d].width <= HISTOGRAM_LANE_BITS;
+	Tc *lane[8 * sizeof(Ti)][HISTOGRAM_LANES > 4 ? HISTOGRAM_LANES : 4];
+	if (lanes) {
+		for (size_t i = 0; i < (size_t) (HISTOGRAM_LANES - 1) * size; i++)
+			mydata.lanes[i] = 0;
+		for (int d = 0; d < count; d++) {
+			lane[d][0] = digit_hist[d];
+			for (int l = 1; l < HISTOGRAM_LANES; l++)
+				lane[d][l] = mydata.lanes + (l - 1) * size + digits[d].row;
 		}
 	}
-}\
 
+	Key my_min = KeyRange<Key>::highest();
+	Key my_max = KeyRange<Key>::lowest();
+	const Ti *pointer = src + mydata.start_i;
+	// the first value of a thread is compared with the last value of the previous thread
+	Key previous = mydata.N > 0 ? RadixTraits<Ti>::key(mydata.start_i > 0 ? pointer[-1] : pointer[0]) : Key();
+	Tc my_descents = 0;
+	// index of each value is written at the place of the next descent (without branches,
+	// which random values would mispredict), so indices of descents stay in runs
+	Tc runs[MERGE_RUNS + 1];
+	if (lanes) {
+		// values are read in blocks which stay in L1 cache, while their digits are counted one digit after another
+		Tc const block = (Tc) (16384 / sizeof(Ti));
+		for (Tc begin = 0, end; begin < mydata.N; begin = end) {
+			end = mydata.N - begin < block ? mydata.N : begin + block;
+			for (Tc z = begin; z < end; z++) {
+				Key value = RadixTraits<Ti>::key(pointer[z]);
+				KeyRange<Key>::update(my_min, my_max, value);
+				runs[my_descents < MERGE_RUNS ? my_descents : MERGE_RUNS] = mydata.start_i + z;
+				my_descents += value < previous;
+				previous = value;
+			}
+			for (int d = 0; d < count; d++)
+				countLanes(pointer + begin, end - begin, lane[d], shift[d], intervals[d], offset);
+		}
+	} else {
+		// all digits of each value are counted together, so increments of different digits do not wait for each other
+		int mask[8 * sizeof(Ti)];
+		for (int d = 0; d < count; d++)
+			mask[d] = intervals[d] - 1;
+		for (Tc z = 0; z < mydata.N; z++) {
+			Key value = RadixTraits<Ti>::key(pointer[z]);
+			KeyRange<Key>::update(my_min, my_max, value);
+			runs[my_descents < MERGE_RUNS ? my_descents : MERGE_RUNS] = mydata.start_i + z;
+			my_descents += value < previous;
+			previous = value;
+			value = KeyRange<Key>::reduce(value, offset);
+			for (int d = 0; d < count; d++)
+				digit_hist[d][(value >> shift[d]) & mask[d]]++;
+		}
+	}
+	if (lanes)
+		for (int l = 1; l < HISTOGRAM_LANES; l++)
+			for (int i = 0; i < size; i++)
+				mydata.hist[i] += mydata.lanes[(l - 1) * size + i];
+	// results of threads are added from threads data (descents are read by sortedRuns too)
+	datas[id].descents = my_descents;
+	for (int r = 0; r < MERGE_RUNS && r < my_descents; r++)
+		datas[id].runs[r] = runs[r];
+	datas[id].minKey = my_min;
+	datas[id].maxKey = my_max;
+#pragma omp barrier
 
-/* Rewrite keys
+	addHistograms(datas, &RsortData<Ti,Tc>::hist, hist, size);
+#pragma omp single
+	{
+		min = KeyRange<Key>::highest();
+		max = KeyRange<Key>::lowest();
+		descents = 0;
+		for (int k = 0; k < omp_get_num_threads(); k++) {
+			descents += datas[k].descents;
+			if (datas[k].N > 0) {
+				KeyRange<Key>::update(min, max, datas[k].minKey);
+				KeyRange<Key>::update(min, max, datas[k].maxKey);
+			}
+		}
+	}
+}
+
+/* Counting the number of bits of each bit interval
+ * (run by every thread of the parallel region of sorting, see RSB)
  *
  * datas - threads data
+ * mydata - data of the calling thread
  * src - input array
- * dest - output array
- *
+ * start_higher - output, number of values of each bit interval in the whole array (NULL if only counts of threads are needed)
+ * iterator - number of bits for which value is needed to be moved
+ * bitIntervals - number of bit intervals
+ * offset - key subtracted from keys of values
  */
-template<class Ti,class Tk>
-void rewriteKeys(Tk *dest,Tk *src,RsortData<Ti>*datas)
-{
-#pragma omp parallel
-	{
-		int id = omp_get_thread_num();
-		RsortData<Ti>mydata = datas[id];
-		Tk *source = src +mydata.start_i;
-		Tk *destination = dest + mydata.start_i;
-		for(int i=0;i<mydata.N;i++)
-		{
-			*(destination++)=*(source++);
-		}
+template<class Ti, class Tc>
+void countBitInterval(const RsortData<Ti,Tc> *datas, RsortData<Ti,Tc> &mydata, const Ti *src, Tc *start_higher, int iterator, int bitIntervals,
+		const typename RadixTraits<Ti>::Key &offset) {
+	for (int i = 0; i < bitIntervals; i++)
+		mydata.bits[i] = 0;
+
+	countDigits(src + mydata.start_i, mydata.N, mydata.bits, mydata.lanes, iterator, bitIntervals, offset);
+
+	if (start_higher != NULL) {
+#pragma omp barrier
+		addHistograms(datas, &RsortData<Ti,Tc>::bits, start_higher, bitIntervals);
+#pragma omp barrier
 	}
+}
 
+/* Loading the number of values of each bit interval from histograms counted by countHistograms
+ *
+ * mydata - data of the calling thread
+ * row - index of the histogram of the digit in histograms
+ * bitIntervals - number of bit intervals
+ */
+template<class Ti, class Tc>
+inline void loadHistogram(RsortData<Ti,Tc> &mydata, int row, int bitIntervals) {
+	memcpy(mydata.bits, mydata.hist + row, bitIntervals * sizeof(Tc));
 }
 
-/* Determine keys
+/* Loading the number of values of each bit interval from counters of the previous pass
+ * (the calling thread adds counters of its part of array of all threads, see NextDigitCounter)
  *
- * key_src - input keys array
- * key_dest - output keys array
  * datas - threads data
- * N - number of values
- *
+ * mydata - data of the calling thread
+ * t - number of threads
+ * bitIntervals - number of bit intervals
  */
-template<class Ti, class Tk>
-void determineKey(Tk *key_src, Tk *key_dest,RsortData<Ti> *datas,int N)
-{
-#pragma omp parallel
-	{
-		int id = omp_get_thread_num();
-		RsortData<Ti> mydata = datas[id];
-
-		Tk *pointer = key_src + mydata.start_i;
-		for (int i = 0; i < mydata.N; i++){
-			key_dest[*pointer] = mydata.start_i+i;
-			pointer++;
-		}
+template<class Ti, class Tc>
+void loadNextHistogram(const RsortData<Ti,Tc> *datas, RsortData<Ti,Tc> &mydata, int t, int bitIntervals) {
+	int id = omp_get_thread_num();
+	memcpy(mydata.bits, datas[0].next + (size_t) id * bitIntervals, bitIntervals * sizeof(Tc));
+	for (int k = 1; k < t; k++) {
+		const Tc *counts = datas[k].next + (size_t) id * bitIntervals;
+		for (int i = 0; i < bitIntervals; i++)
+			mydata.bits[i] += counts[i];
 	}
-
 }
 
-/* Proper radix sorting
+/* Calculating starting indices for each bits interval
  *
- * src - input values array
- * temp - temporary values array
- * key - input keys array
- * temp_key - temporary keys array
+ * Numbers of values of each bit interval of all threads are gathered into one matrix
+ * (bit interval after bit interval, thread after thread), so its exclusive prefix sum
+ * gives the index from which each thread inserts values of each bit interval.
+ * Each thread scans the rows of its own block of bit intervals (run by every thread
+ * of the parallel region of sorting, starting indices are known to all threads when it returns).
+ *
+ * t- number of threads
  * datas - threads data
- * N - number of values
+ * scan - work space of 2 x t x bitIntervals + t counters
+ * start_index - starting index
  * bitIntervals - number of bit intervals
  */
-template<class Ti,class Tk>
-void RSB(Ti* src, Ti * temp,Tk *key,Tk *temp_key, RsortData<Ti> * datas, const int N, int bitCount, LVTimer *timers )
-{
-        int const bitIntervals = 1<<bitCount;
-	Ti * t1 = src;
-	Ti * t2 = temp;
+template<class Ti, class Tc>
+void calculateStartingIndices(int t, RsortData<Ti,Tc> *datas, Tc *scan,
+		Tc start_index, int bitIntervals) {
+	Tc *counts = scan;
+	Tc *starts = counts + (size_t) t * bitIntervals;
+	Tc *sums = starts + (size_t) t * bitIntervals;
+	int id = omp_get_thread_num();
+	int const first = (int) ((long long) bitIntervals * id / t);
+	int const last = (int) ((long long) bitIntervals * (id + 1) / t);
+	size_t const begin = (size_t) first * t;
+	size_t const end = (size_t) last * t;
 
-	Tk * k1 = key;
-	Tk * k2 = temp_key;
+	// rows of the block (other threads are read, only the own block is written)
+	for (int k = 0; k < t; k++) {
+		const Tc *bits = datas[k].bits;
+		for (int j = first; j < last; j++)
+			counts[(size_t) j * t + k] = bits[j];
+	}
+	Tc sum = 0;
+#pragma omp simd reduction(+:sum)
+	for (size_t i = begin; i < end; i++)
+		sum += counts[i];
+	sums[id] = sum;
+#pragma omp barrier
 
-	//number of threads
-	int t = 0;
-#pragma omp parallel
-	if (omp_get_thread_num()==0 )
-		t = omp_get_num_threads();
+	Tc prefix = start_index;
+	for (int k = 0; k < id; k++)
+		prefix += sums[k];
+#if OMP_SCAN
+#pragma omp simd reduction(inscan, +:prefix)
+#endif
+	for (size_t i = begin; i < end; i++) {
+		starts[i] = prefix;
+#if OMP_SCAN
+#pragma omp scan exclusive(prefix)
+#endif
+		prefix += counts[i];
+	}
 
-	//array of indices from which each bit interval begins
-	int *start_higher = new int[bitIntervals ];
-	Ti max = t1[0];
+	// starting indices are returned to threads
+	for (int k = 0; k < t; k++) {
+		Tc *bits = datas[k].bits;
+		for (int j = first; j < last; j++)
+			bits[j] = starts[(size_t) j * t + k];
+	}
+#pragma omp barrier
+}
 
-	//okresla sprawdzany bit
-	int iterator = 0;
+/* Checking if values and keys are inserted through write combining buffers
+ *
+ * bitCount - number of bits in one digit
+ */
+template<class Ti, class Tk>
+bool useWriteCombining(int bitCount) {
+	// buffered values and keys are written as raw bytes, cache line has to hold whole values
+	if (!is_trivially_copyable<Ti>::value || !is_trivially_copyable<Tk>::value
+			|| CACHE_LINE % sizeof(Ti) != 0 || bitCount <= 0 || bitCount > WRITE_COMBINE_BITS)
+		return false;
+#if WRITE_COMBINE==1
+	return true;
+#elif WRITE_COMBINE==2
+	return bitCount >= 8;
+#else
+	return false;
+#endif
+}
 
-	// counting max value
+/* Size of write combining buffer of one thread in bytes
+ * (cache line of values, corresponding keys and starting index for each bit interval)
+ *
+ * bitIntervals - number of bit intervals
+ */
+template<class Ti, class Tk>
+size_t writeCombiningBufferSize(int bitIntervals) {
+	return (size_t) bitIntervals * (CACHE_LINE + CACHE_LINE / sizeof(Ti) * sizeof(Tk) + sizeof(typename RsortCounter<Tk>::type));
+}
 
-        if(timers!=NULL)
-            timers->timerStart(1);
+// Keys inserted together with values
+enum KeysMode {
+	KEYS_NONE = 0,	// keys are not inserted
+	KEYS_MOVE = 1,	// keys are moved from the input keys array
+	KEYS_INDEX = 2	// keys are indices of values in the input array
+};
 
+/* Checking if digits of the next pass are counted while values are inserted
+ * (each thread needs counters of the next digit for the part of every thread
+ * and the thread and the end of its part for each bit interval of this pass)
+ *
+ * datas - threads data
+ * t - number of threads
+ * width - number of bits of the digit of this pass
+ * nextWidth - number of bits of the digit of the next pass
+ */
+template<class Ti, class Tc>
+bool countsNextDigit(const RsortData<Ti,Tc> *datas, int t, int width, int nextWidth) {
+	if (!FUSED_COUNT || t == 1)
+		return false;
+	size_t needed = ((size_t) t << nextWidth) + ((size_t) 2 << width);
+	for (int k = 0; k < t; k++)
+		if (datas[k].nextSize < needed)
+			return false;
+	return true;
+}
 
-	max = countMax(datas, t1);
+// Counting digits of the next pass while values of one thread are inserted.
+// The next pass reads the output array in parts of threads, so the next digit of each value
+// is counted for the thread whose part it is inserted into. Values of a bit interval are counted
+// for the thread which receives its first value; only t - 1 ends of parts fall into bit intervals
+// of all threads, so values inserted after such an end are moved to their threads by finish.
+//
+template<class Ti, class Tc>
+struct NextDigitCounter {
+	typedef typename RadixTraits<Ti>::Key Key;
 
-        if(timers!=NULL)
-            timers->timerEnd(1);
+	// threads data
+	const RsortData<Ti,Tc> *datas;
 
+	// number of threads
+	int t;
 
-	//main loop
-	while (max>0) {
+	// t x bitIntervals counters of the next digit (thread after thread)
+	Tc *counts;
 
- 
- 
-            if(timers!=NULL)
-                timers->timerStart(2);
+	// counters of the thread which receives the first value of each bit interval of this pass
+	Tc *row;
 
+	// end of its part of array
+	Tc *end;
 
-		// Counting the number of bits of each bit interval
-		countBitInterval(datas, t1, start_higher, iterator,bitIntervals);
+	int iterator;
+	int bitIntervals;
+	int passIntervals;
 
-            if(timers!=NULL)
-	    {
-		timers->add(2);
-	    	timers->timerStart(3);
+	/* datas - threads data
+	 * t - number of threads
+	 * mydata - data of the inserting thread (bits hold its starting indices)
+	 * passIntervals - number of bit intervals of this pass
+	 * iterator, bitIntervals - digit of the next pass
+	 */
+	NextDigitCounter(const RsortData<Ti,Tc> *datas, int t, const RsortData<Ti,Tc> &mydata, int passIntervals,
+			int iterator, int bitIntervals)
+			: datas(datas), t(t), iterator(iterator), bitIntervals(bitIntervals), passIntervals(passIntervals) {
+		counts = mydata.next;
+		row = counts + (size_t) t * bitIntervals;
+		end = row + passIntervals;
+		for (size_t i = 0; i < (size_t) t * bitIntervals; i++)
+			counts[i] = 0;
+		// starting indices grow with bit intervals
+		int k = 0;
+		for (int i = 0; i < passIntervals; i++) {
+			while (k < t - 1 && datas[k].start_i + datas[k].N <= mydata.bits[i])
+				k++;
+			row[i] = (Tc) k * bitIntervals;
+			end[i] = datas[k].start_i + datas[k].N;
+		}
+	}
+
+	inline void count(int index, const Ti &value, const Key &offset) {
+		counts[row[index] + digitOf(value, iterator, bitIntervals, offset)]++;
+	}
+
+	/* Moving counts of values inserted after the end of the part of the first thread of their bit interval
+	 *
+	 * positions - index after the last inserted value of each bit interval
+	 * dest - output array
+	 * offset - key subtracted from keys of values
+	 */
+	void finish(const Tc *positions, const Ti *dest, const Key &offset) {
+		for (int i = 0; i < passIntervals; i++) {
+			int k = (int) (row[i] / bitIntervals);
+			for (Tc position = end[i]; position < positions[i]; position++) {
+				while (position >= datas[k].start_i + datas[k].N)
+					k++;
+				int digit = digitOf(dest[position], iterator, bitIntervals, offset);
+				counts[row[i] + digit]--;
+				counts[(size_t) k * bitIntervals + digit]++;
+			}
+		}
+	}
+};
+
+// Inserting values without counting digits of the next pass
+//
+template<class Ti>
+struct NoDigitCounter {
+	inline void count(int, const Ti &, const typename RadixTraits<Ti>::Key &) {
+	}
+	template<class Tc>
+	inline void finish(const Tc *, const Ti *, const typename RadixTraits<Ti>::Key &) {
+	}
+};
+
+/* Inserting values of one thread into output array through write combining buffers
+ *
+ * Values and keys of each bit interval are collected in a buffer of one cache line,
+ * full lines are written with streaming stores. Lines shared with other threads
+ * (first and last line of thread's part of bit interval) are written with ordinary stores.
+ *
+ * keys - keys inserted together with values (KeysMode)
+ * mydata - thread data
+ * src - input array
+ * dest - output array
+ * iterator - number of bits for which value is needed to be moved
+ * bitIntervals - number of bit intervals
+ * offset - key subtracted from keys of values
+ * counter - counter of digits of the next pass (NextDigitCounter or NoDigitCounter)
+ */
+template<int keys, class Ti,class Tk, class Tc, class Counter>
+void insertValuesBuffered(RsortData<Ti,Tc> &mydata, const Ti *src, Ti *dest,Tk *src_key,Tk *dest_key, int iterator, int bitIntervals,
+		const typename RadixTraits<Ti>::Key &offset, Counter &counter) {
+	int const line = CACHE_LINE / sizeof(Ti);
+	// position of dest in its cache line
+	int const shift = (int) (((uintptr_t) dest % CACHE_LINE) / sizeof(Ti));
+
+	Ti *values = (Ti *) mydata.buffer;
+	Tk *key_values = (Tk *) (mydata.buffer + (size_t) bitIntervals * CACHE_LINE);
+	Tc *begin = (Tc *) (key_values + (size_t) bitIntervals * line);
+	for (int i = 0; i < bitIntervals; i++)
+		begin[i] = mydata.bits[i];
+
+	const Ti *pointer = src + mydata.start_i;
+	Tk *key_pointer = keys == KEYS_MOVE ? src_key + mydata.start_i : NULL;
+	for (Tc i = 0; i < mydata.N; i++) {
+		int index = digitOf(*pointer, iterator, bitIntervals, offset);
+		Tc position = mydata.bits[index]++;
+		int slot = (position + shift) & (line - 1);
+		counter.count(index, *pointer, offset);
+		values[index * line + slot] = *(pointer++);
+		if (keys == KEYS_MOVE)
+			key_values[index * line + slot] = *(key_pointer++);
+		else if (keys == KEYS_INDEX)
+			key_values[index * line + slot] = (Tk) (mydata.start_i + i);
+
+		if (slot == line - 1) {
+			Tc first = position - slot;
+			if (first >= begin[index]) {
+				streamBytes(dest + first, values + index * line, CACHE_LINE);
+				if (keys != KEYS_NONE)
+					streamBytes(dest_key + first, key_values + index * line, line * sizeof(Tk));
+			} else {
+				Tc count = position + 1 - begin[index];
+				memcpy((void *) (dest + begin[index]), values + index * line + line - count, count * sizeof(Ti));
+				if (keys != KEYS_NONE)
+					memcpy(dest_key + begin[index], key_values + index * line + line - count, count * sizeof(Tk));
+			}
+		}
+	}
+
+	// values left in buffers
+	for (int index = 0; index < bitIntervals; index++) {
+		Tc position = mydata.bits[index];
+		Tc first = position - ((position + shift) & (line - 1));
+		if (first < begin[index])
+			first = begin[index];
+		Tc count = position - first;
+		if (count > 0) {
+			int slot = (first + shift) & (line - 1);
+			memcpy((void *) (dest + first), values + index * line + slot, count * sizeof(Ti));
+			if (keys != KEYS_NONE)
+				memcpy(dest_key + first, key_values + index * line + slot, count * sizeof(Tk));
+		}
+	}
+	streamFence();
+	counter.finish(mydata.bits, dest, offset);
+}
+
+/* Inserting values of one thread into output array
+ *
+ * keys - keys inserted together with values (KeysMode)
+ * mydata - thread data
+ * src - input array
+ * dest - output array
+ * iterator - number of bits for which value is needed to be moved
+ * bitIntervals - number of bit intervals
+ * offset - key subtracted from keys of values
+ * counter - counter of digits of the next pass (NextDigitCounter or NoDigitCounter)
+ */
+template<int keys, class Ti,class Tk, class Tc, class Counter>
+void insertValuesDirect(RsortData<Ti,Tc> &mydata, const Ti *src, Ti *dest,Tk *src_key,Tk *dest_key, int iterator, int bitIntervals,
+		const typename RadixTraits<Ti>::Key &offset, Counter &counter) {
+	for (int i = 0; i < bitIntervals; i++){
+		mydata.start[i] = dest + mydata.bits[i];
+	}
+
+	const Ti *pointer = src + mydata.start_i;
+	Tk *key_pointer = keys == KEYS_MOVE ? src_key + mydata.start_i : NULL;
+	for (Tc i = 0; i < mydata.N; i++) {
+		int index = digitOf(*pointer, iterator, bitIntervals, offset);
+		counter.count(index, *pointer, offset);
+		if (keys == KEYS_MOVE)
+			*(dest_key +mydata.bits[index]++) = *(key_pointer++);
+		else if (keys == KEYS_INDEX)
+			*(dest_key +mydata.bits[index]++) = (Tk) (mydata.start_i + i);
+
+		*(mydata.start[index]++) =*(pointer++);
+	}
+
+	// index after the last value of each bit interval (keys moved bits already)
+	if (keys == KEYS_NONE)
+		for (int i = 0; i < bitIntervals; i++)
+			mydata.bits[i] = (Tc) (mydata.start[i] - dest);
+	counter.finish(mydata.bits, dest, offset);
+}
+
+/* Inserting values of one thread into output array with the kernel of its keys
+ *
+ * mydata - thread data
+ * src - input array
+ * dest - output array
+ * src_key - input keys array (NULL if keys are indices of values in src or are not inserted)
+ * dest_key - output keys array (NULL if keys are not inserted)
+ * iterator - number of bits for which value is needed to be moved
+ * bitIntervals - number of bit intervals
+ * buffered - values are inserted through write combining buffers of threads
+ * offset - key subtracted from keys of values
+ * counter - counter of digits of the next pass (NextDigitCounter or NoDigitCounter)
+ */
+template<class Ti,class Tk, class Tc, class Counter>
+void insertThreadValues(RsortData<Ti,Tc> &mydata, const Ti *src, Ti *dest,Tk *src_key,Tk *dest_key, int iterator, int bitIntervals, bool buffered,
+		const typename RadixTraits<Ti>::Key &offset, Counter &counter) {
+	int keys = src_key != NULL ? KEYS_MOVE : (dest_key != NULL ? KEYS_INDEX : KEYS_NONE);
+	if (buffered && keys == KEYS_MOVE)
+		insertValuesBuffered<KEYS_MOVE>(mydata, src, dest, src_key, dest_key, iterator, bitIntervals, offset, counter);
+	else if (buffered && keys == KEYS_INDEX)
+		insertValuesBuffered<KEYS_INDEX>(mydata, src, dest, src_key, dest_key, iterator, bitIntervals, offset, counter);
+	else if (buffered)
+		insertValuesBuffered<KEYS_NONE>(mydata, src, dest, src_key, dest_key, iterator, bitIntervals, offset, counter);
+	else if (keys == KEYS_MOVE)
+		insertValuesDirect<KEYS_MOVE>(mydata, src, dest, src_key, dest_key, iterator, bitIntervals, offset, counter);
+	else if (keys == KEYS_INDEX)
+		insertValuesDirect<KEYS_INDEX>(mydata, src, dest, src_key, dest_key, iterator, bitIntervals, offset, counter);
+	else
+		insertValuesDirect<KEYS_NONE>(mydata, src, dest, src_key, dest_key, iterator, bitIntervals, offset, counter);
+}
+
+/* Inserting values into output array
+ * (run by every thread of the parallel region of sorting, values are inserted when it returns)
+ *
+ * datas - threads data
+ * mydata - data of the calling thread
+ * src - input array
+ * dest - output array
+ * src_key - input keys array (NULL if keys are indices of values in src or are not inserted)
+ * dest_key - output keys array (NULL if keys are not inserted)
+ * iterator - number of bits for which value is needed to be moved
+ * bitIntervals - number of bit intervals
+ * buffered - values are inserted through write combining buffers of threads
+ * offset - key subtracted from keys of values
+ * nextIterator, nextIntervals - digit of the next pass counted while values are inserted
+ *                               (nextIntervals 0 - no digits are counted, see NextDigitCounter)
+ */
+template<class Ti,class Tk, class Tc>
+void insertValues(const RsortData<Ti,Tc> *datas, RsortData<Ti,Tc> &mydata, const Ti *src, Ti *dest,Tk *src_key,Tk *dest_key, int iterator,int t, int bitIntervals, bool buffered,
+		const typename RadixTraits<Ti>::Key &offset, int nextIterator, int nextIntervals) {
+	if (nextIntervals > 0) {
+		NextDigitCounter<Ti,Tc> counter(datas, t, mydata, bitIntervals, nextIterator, nextIntervals);
+		insertThreadValues(mydata, src, dest, src_key, dest_key, iterator, bitIntervals, buffered, offset, counter);
+	} else {
+		NoDigitCounter<Ti> counter;
+		insertThreadValues(mydata, src, dest, src_key, dest_key, iterator, bitIntervals, buffered, offset, counter);
+	}
+#pragma omp barrier
+}
+
+/* Copy array
+ * (values which can be copied as bytes are copied by memcpy, which the C library
+ * chooses for instruction sets of the CPU)
+ *
+ * mydata - data of the calling thread, which copies its part of array
+ * dest - output array
+ * src - input array
+ */
+template<class Ti, class Tc>
+void copyArray(const RsortData<Ti,Tc> &mydata,Ti * dest, Ti *src) {
+	Ti *source = src + mydata.start_i;
+
+	Ti *destination = dest + mydata.start_i;
+	if (is_trivially_copyable<Ti>::value) {
+		memcpy((void *) destination, source, (size_t) mydata.N * sizeof(Ti));
+	} else {
+		for (Tc i = 0; i < mydata.N; i++){
+			*(destination++) = *source++;
+		}
+	}
+}
+
+
+/* Rewrite keys
+ * (keys which can be copied as bytes are copied by memcpy, see copyArray)
+ *
+ * mydata - data of the calling thread, which rewrites its part of array
+ * src - input array
+ * dest - output array
+ *
+ */
+template<class Ti,class Tk, class Tc>
+void rewriteKeys(Tk *dest,Tk *src,const RsortData<Ti,Tc> &mydata)
+{
+	Tk *source = src +mydata.start_i;
+	Tk *destination = dest + mydata.start_i;
+	if (is_trivially_copyable<Tk>::value)
+	{
+		memcpy((void *) destination, source, (size_t) mydata.N * sizeof(Tk));
+	}
+	else
+	{
+		for(Tc i=0;i<mydata.N;i++)
+		{
+			*(destination++)=*(source++);
+		}
+	}
+
+}
+
+/* Determine keys
+ * (keys of the part of array of the calling thread are written to the whole output array,
+ * so they are known to other threads after a barrier)
+ *
+ * key_src - input keys array
+ * key_dest - output keys array
+ * mydata - data of the calling thread
+ *
+ */
+template<class Ti, class Tk, class Tc>
+void determineKey(Tk *key_src, Tk *key_dest,const RsortData<Ti,Tc> &mydata)
+{
+	Tk *pointer = key_src + mydata.start_i;
+	for (Tc i = 0; i < mydata.N; i++){
+		key_dest[*pointer] = (Tk) (mydata.start_i+i);
+		pointer++;
+	}
+
+}
+
+/* One pass of radix sorting - moving values (and keys) by one digit into the other array
+ *
+ * Run by every thread of the parallel region of sorting (see RSB), phases of the pass
+ * are separated by barriers and timers are given only to the master thread.
+ *
+ * datas - threads data
+ * mydata - data of the calling thread
+ * t - number of threads
+ * src - input values array
+ * dest - output values array
+ * src_key - input keys array (NULL if keys are indices of values in src or are not moved)
+ * dest_key - output keys array (NULL if keys are not moved)
+ * scan - work space of calculateStartingIndices
+ * plan - digits which take more than one value
+ * pass - index of the sorted digit in plan
+ * passes - number of digits in plan
+ * buffered - values are inserted through write combining buffers of threads (digits too short for them are written directly)
+ * offset - key subtracted from keys of values
+ */
+template<class Ti,class Tk, class Tc>
+void radixPass(RsortData<Ti,Tc> *datas, RsortData<Ti,Tc> &mydata, int t, const Ti *src, Ti *dest, Tk *src_key, Tk *dest_key, Tc *scan,
+		const Digit *plan, int pass, int passes, bool buffered, const typename RadixTraits<Ti>::Key &offset, LVTimer *timers)
+{
+        int const bitIntervals = 1 << plan[pass].width;
+	buffered = buffered && useWriteCombining<Ti,Tk>(plan[pass].width);
+
+            if(timers!=NULL)
+                timers->timerStart(2);
+
+
+	//okresla sprawdzany bit
+	int iterator = plan[pass].shift;
+
+	// Counting the number of bits of each bit interval
+	// (histograms of the first pass are already known from countHistograms, for one thread
+	// they are known for every pass because the thread always reads the whole array,
+	// other passes are usually counted while the previous pass inserts values)
+	if (pass == 0 || t == 1)
+		loadHistogram(mydata, plan[pass].row, bitIntervals);
+	else if (countsNextDigit(datas, t, plan[pass - 1].width, plan[pass].width))
+		loadNextHistogram(datas, mydata, t, bitIntervals);
+	else
+		countBitInterval(datas, mydata, src, (Tc *) NULL, iterator,bitIntervals, offset);
+
+	// starting indices need counts of all threads
+#pragma omp barrier
+
+            if(timers!=NULL)
+	    {
+		timers->add(2);
+	    	timers->timerStart(3);
+	    }
+
+
+	// Calculating starting indices for each bits interval
+	calculateStartingIndices<Ti,Tc>( t, datas, scan, 0,bitIntervals);
+
+            if(timers!=NULL)
+            {
+	        timers->add(3);
+		timers->timerStart(4);
+	    }
+
+
+	// Inserting values into output array
+	bool counted = pass + 1 < passes && countsNextDigit(datas, t, plan[pass].width, plan[pass + 1].width);
+	insertValues(datas, mydata, src, dest,src_key,dest_key, iterator,t,bitIntervals,buffered, offset,
+			counted ? plan[pass + 1].shift : 0, counted ? 1 << plan[pass + 1].width : 0);
+            if(timers!=NULL)
+    	        timers->add(4);
+}
+
+/* Cost model of sorting used when bitCount is 0 to choose the digit width and the number of threads
+ *
+ * Costs of one pass are given for every digit width, with one thread and with all threads
+ * (speedup of threads is limited by memory controllers, not by cores).
+ * Default costs are rough, calibrate measures them on the host for values of one size.
+ */
+struct TuneModel {
+
+	// size of values in bytes
+	int valueSize;
+
+	// number of threads costs of all threads were measured with (0 - default costs)
+	int threads;
+
+	// ns of one pass over one value with one thread for digits of 0 - TUNE_BITS bits
+	double single[TUNE_BITS + 1];
+
+	// ns of one pass over one value with all threads for digits of 0 - TUNE_BITS bits
+	double all[TUNE_BITS + 1];
+
+	// ns of one pass over one bit interval (counts of threads are added and starting indices are calculated
+	// by all threads together, each thread for its own block of bit intervals, see addHistograms)
+	double merge;
+
+	// ns of one parallel region
+	double region;
+
+	TuneModel(int valueSize = 4) {
+		this->valueSize = valueSize;
+		threads = 0;
+		merge = 1.0;
+		region = 2000.0;
+		// bit intervals of longer digits do not fit in L1, then in L2 and TLB
+		for (int b = 0; b <= TUNE_BITS; b++) {
+			single[b] = (b <= 8 ? 1.0 : b <= 11 ? 1.0 + 0.15 * (b - 8) : 1.45 + 0.6 * (b - 11)) * (valueSize + 4) / 8.0;
+			all[b] = single[b];
+		}
+	}
+
+	/* Estimated time of sorting in ns
+	 *
+	 * N - number of values
+	 * keyBits - number of bits of the range of keys
+	 * bitCount - number of sorted bits in one iteration
+	 * t - number of threads
+	 * scale - cost of moving one value (and its key) relative to the value alone
+	 */
+	double cost(size_t N, int keyBits, int bitCount, int t, double scale) const {
+		int passes = (keyBits + bitCount - 1) / bitCount;
+		// threads speed sorting up until memory controllers are saturated
+		double saturated = threads == 0 ? 6.0 * numaTopology().nodes : single[bitCount] / all[bitCount];
+		double speed = t < saturated ? t : saturated;
+		return passes * ((double) N * single[bitCount] * scale / speed + (double) (1 << bitCount) * merge + 4 * region)
+				+ 2 * region;
+	}
+
+	/* Choosing the digit width and the number of threads of the lowest cost
+	 *
+	 * N - number of values
+	 * keyBits - number of bits of the range of keys
+	 * maxThreads - maximal number of threads
+	 * scale - cost of moving one value (and its key) relative to the value alone
+	 * bitCount - output, number of sorted bits in one iteration
+	 * t - output, number of threads
+	 */
+	void choose(size_t N, int keyBits, int maxThreads, double scale, int &bitCount, int &t) const {
+		double best = 0;
+		bitCount = 8;
+		t = maxThreads;
+		for (int b = 4; b <= TUNE_BITS; b++)
+			for (int threads = 1; threads <= maxThreads; threads++) {
+				double time = cost(N, keyBits > 0 ? keyBits : 1, b, threads, scale);
+				if (best == 0 || time < best) {
+					best = time;
+					bitCount = b;
+					t = threads;
+				}
+			}
+	}
+};
+
+/* Cost models of every size of values (1, 2, 4, 8 and 16 bytes)
+ * loaded from the file of the host (see TUNE)
+ *
+ * The file is $PRADSORT_TUNE_FILE or $HOME/.pradsort-<host name>.tune, so hosts sharing
+ * home directory keep their own models. Each line holds one model measured by calibrate.
+ */
+struct TuneCache {
+
+	TuneModel models[5];
+
+	// path of the file
+	char path[512];
+
+	TuneCache() {
+		for (int i = 0; i < 5; i++)
+			models[i] = TuneModel(1 << i);
+		path[0] = 0;
+#ifdef linux
+		const char *file = getenv("PRADSORT_TUNE_FILE");
+		const char *home = getenv("HOME");
+		char host[128];
+		if (gethostname(host, sizeof(host)) != 0)
+			strcpy(host, "localhost");
+		host[sizeof(host) - 1] = 0;
+		if (file != NULL)
+			snprintf(path, sizeof(path), "%s", file);
+		else if (home != NULL)
+			snprintf(path, sizeof(path), "%s/.pradsort-%s.tune", home, host);
+#if TUNE>0
+		load();
+#endif
+#endif
+	}
+
+	/* Model of values of size valueSize
+	 */
+	TuneModel &model(int valueSize) {
+		int i = 0;
+		while (i < 4 && (1 << i) < valueSize)
+			i++;
+		return models[i];
+	}
+
+	/* Loading measured models from the file
+	 */
+	void load() {
+		FILE *file = path[0] != 0 ? fopen(path, "r") : NULL;
+		if (file == NULL)
+			return;
+		TuneModel read;
+		while (fscanf(file, "%d %d %lf %lf", &read.valueSize, &read.threads, &read.merge, &read.region) == 4) {
+			bool complete = true;
+			for (int b = 0; b <= TUNE_BITS && complete; b++)
+				complete = fscanf(file, "%lf %lf", &read.single[b], &read.all[b]) == 2;
+			if (!complete)
+				break;
+			if (read.threads > 0)
+				model(read.valueSize) = read;
+		}
+		fclose(file);
+	}
+
+	/* Saving measured models in the file (returns false if it could not be written)
+	 */
+	bool save() const {
+#ifdef linux
+		if (path[0] == 0)
+			return false;
+		char temporary[540];
+		snprintf(temporary, sizeof(temporary), "%s.%d", path, (int) getpid());
+		FILE *file = fopen(temporary, "w");
+		if (file == NULL)
+			return false;
+		for (int i = 0; i < 5; i++) {
+			const TuneModel &m = models[i];
+			if (m.threads == 0)
+				continue;
+			fprintf(file, "%d %d %g %g", m.valueSize, m.threads, m.merge, m.region);
+			for (int b = 0; b <= TUNE_BITS; b++)
+				fprintf(file, " %g %g", m.single[b], m.all[b]);
+			fprintf(file, "\n");
+		}
+		// other processes read either the old or the new file
+		bool saved = fclose(file) == 0 && rename(temporary, path) == 0;
+		if (!saved)
+			remove(temporary);
+		return saved;
+#else
+		return false;
+#endif
+	}
+};
+
+/* Cost models of the host (loaded once)
+ */
+inline TuneCache &tuneCache() {
+	static TuneCache cache;
+	return cache;
+}
+
+template<class Ti>
+TuneModel calibrate();
+
+/* Cost model of sorting values of type Ti (see TUNE)
+ */
+template<class Ti>
+const TuneModel &tuneModel() {
+	TuneModel &model = tuneCache().model(sizeof(Ti));
+#if TUNE==2
+	if (model.threads == 0)
+		calibrate<Ti>();
+#endif
+	return model;
+}
+
+/* Number of bits of the range of keys estimated from a sample of values
+ * (estimation only guides the choice of digit width, values outside the sample are sorted anyway)
+ *
+ * src - input values array (NULL if values are not known yet)
+ * N - number of values
+ */
+template<class Ti>
+int estimateKeyBits(const Ti *src, size_t N) {
+	typedef typename RadixTraits<Ti>::Key Key;
+	int const width = 8 * sizeof(Ti);
+	if (src == NULL || N == 0)
+		return width;
+	Key min = KeyRange<Key>::highest();
+	Key max = KeyRange<Key>::lowest();
+	size_t step = N / 1024 + 1;
+	for (size_t i = 0; i < N; i += step)
+		KeyRange<Key>::update(min, max, RadixTraits<Ti>::key(src[i]));
+	int bits = KeyRange<Key>::digits(min, max, 1);
+	return bits < width ? bits : width;
+}
+
+/* Checking if values are sorted by counting sort instead of radix passes
+ * (counting sort replaces two or more passes by one when the range of keys is short)
+ *
+ * passes - number of planned passes
+ * rangeBits - number of bits of the range of keys
+ * countingBits - maximal number of bits of the range of keys sorted by counting sort
+ */
+inline bool useCountingSort(int passes, int rangeBits, int countingBits) {
+	return passes > 1 && rangeBits <= countingBits;
+}
+
+/* Filling sorted values from the histogram of the only digit which takes more than one value
+ * (integers are known from their keys, so they need not be moved, other values are not filled;
+ * run by every thread of the parallel region of sorting, each thread fills its own part of output array)
+ *
+ * mydata - data of the calling thread
+ * dest - output values array
+ * counts - histogram of the digit (it is turned into indices where bit intervals end)
+ * bitIntervals - number of bit intervals
+ * offset - key subtracted from keys of values
+ * min - minimal key
+ * iterator - number of bits for which value is needed to be moved
+ */
+template<class Ti, class Tc>
+typename enable_if<is_integral<Ti>::value>::type fillValues(const RsortData<Ti,Tc> &mydata, Ti *dest, Tc *counts, int bitIntervals,
+		const typename RadixTraits<Ti>::Key &offset, const typename RadixTraits<Ti>::Key &min, int iterator) {
+	typedef typename RadixTraits<Ti>::Key Key;
+	int const keys = bitIntervals;
+	// other digits are the same in all keys
+	Key const base = offset + ((Key) (min - offset) & ~((Key) (bitIntervals - 1) << iterator));
+#pragma omp single
+	for (int i = 1; i < keys; i++)
+		counts[i] += counts[i - 1];
+
+	Tc position = mydata.start_i;
+	Tc end = mydata.start_i + mydata.N;
+	int index = (int) (upper_bound(counts, counts + keys, position) - counts);
+	for (; position < end; index++) {
+		Ti value = RadixTraits<Ti>::value(base + ((Key) index << iterator));
+		Tc stop = counts[index] < end ? counts[index] : end;
+		for (; position < stop; position++)
+			dest[position] = value;
+	}
+}
+
+template<class Ti, class Tc>
+typename enable_if<!is_integral<Ti>::value>::type fillValues(const RsortData<Ti,Tc> &, Ti *, Tc *, int,
+		const typename RadixTraits<Ti>::Key &, const typename RadixTraits<Ti>::Key &, int) {
+}
+
+/* Counting sort of integers whose keys differ by less than 2^rangeBits
+ * (one reading of values to count them, then sorted values are filled from their histogram;
+ * run by every thread of the parallel region of sorting)
+ *
+ * datas - threads data
+ * mydata - data of the calling thread
+ * src - values array
+ * counts - work space of 2^rangeBits counters
+ * rangeBits - number of bits of the range of keys
+ * min - minimal key
+ */
+template<class Ti, class Tc>
+void countingSort(RsortData<Ti,Tc> *datas, RsortData<Ti,Tc> &mydata, Ti *src, Tc *counts, int rangeBits,
+		const typename RadixTraits<Ti>::Key &min, LVTimer *timers)
+{
+	int const keys = 1 << rangeBits;
+
+            if(timers!=NULL)
+                timers->timerStart(2);
+
+	// threads grow their arrays of bit intervals by themselves, so they are placed in their Numa nodes
+	datas[omp_get_thread_num()].reserveBits(rangeBits);
+	mydata = datas[omp_get_thread_num()];
+	countBitInterval(datas, mydata, (const Ti *) src, counts, 0, keys, min);
+
+            if(timers!=NULL)
+	    {
+		timers->add(2);
+	    	timers->timerStart(4);
 	    }
 
+	fillValues(mydata, src, counts, keys, min, min, 0);
+
+            if(timers!=NULL)
+    	        timers->add(4);
+}
+
+/* Choosing counted digits which take more than one value, narrowed to the bits they need
+ * (returns the number of passes, rows of narrowed digits point to their bit intervals in histograms)
+ *
+ * hist - histograms of counted digits
+ * digits - counted digits
+ * count - number of counted digits
+ * plan - output, digits sorted in passes
+ */
+template<class Tc>
+int planDigits(const Tc *hist, const Digit *digits, int count, Digit *plan) {
+	int passes = 0;
+	for (int d = 0; d < count; d++) {
+		int lowest;
+		int width = digitWidth(hist + digits[d].row, digits[d].width, lowest);
+		if (width > 0) {
+			plan[passes] = digits[d];
+			plan[passes].width = width;
+			plan[passes++].row += lowest & ~((1 << width) - 1);
+		}
+	}
+	return passes;
+}
+
+/* Digits of nearly equal width covering bits from low to high
+ *
+ * digits - output, digits
+ * low, high - covered bits
+ * count - number of digits
+ */
+inline void balancedDigits(Digit *digits, int low, int high, int count) {
+	for (int d = 0; d < count; d++) {
+		digits[d].shift = low + (high - low) * d / count;
+		digits[d].width = low + (high - low) * (d + 1) / count - digits[d].shift;
+		digits[d].row = d > 0 ? digits[d - 1].row + (1 << digits[d - 1].width) : 0;
+	}
+}
+
+// Passes planned by planPasses, shared by all threads of the parallel region of sorting
+// (threads read them after barriers, only one thread writes them).
+//
+template<class Ti, class Tc>
+struct PassPlan {
+	typedef typename RadixTraits<Ti>::Key Key;
+
+	// digits sorted in passes
+	Digit plan[8 * sizeof(Ti)];
+
+	// number of passes
+	int passes;
+
+	// counted digits
+	Digit digits[8 * sizeof(Ti)];
+
+	// number of counted digits
+	int count;
+
+	// key subtracted from keys of values in all passes
+	Key offset;
+
+	// minimal and maximal key of values (integer keys only)
+	Key min;
+	Key max;
+
+	// number of bits of the range of keys (INT_MAX if keys are not integers)
+	int rangeBits;
+
+	// histograms are counted again for keys decreased by the minimal key
+	bool reduced;
+
+	// number of digits of nearly equal width counted again (0 - none)
+	int balanced;
+
+	// number of values smaller than their predecessor (see countHistograms)
+	Tc descents;
+
+	// number of sorted runs and indices from which they begin (see sortedRuns)
+	int runs;
+	Tc bounds[MERGE_RUNS + 2];
+};
+
+/* Counting histograms of every digit and planning passes
+ * (returns the number of passes)
+ *
+ * When keys decreased by the minimal key need fewer passes than keys themselves
+ * (e.g. values from 1000000000 to 1000065535 need 2 passes of 8 bits instead of 3),
+ * histograms are counted again for decreased keys. It is not done when
+ * values are left for counting sort (see useCountingSort).
+ *
+ * Digits are narrowed to the bits their values need, so the highest pass covers only the remaining
+ * bits (e.g. 30 bits of keys with 11 bit digits are sorted by 11 + 11 + 8 bits). When the cost model
+ * of the host (see TuneModel) says that digits of nearly equal width are faster, even after one more
+ * reading of values to count them, histograms are counted again for them (e.g. 12 + 12 instead of 16 + 8 bits).
+ *
+ * Run by every thread of the parallel region of sorting, plans are made by one thread.
+ *
+ * datas - threads data
+ * mydata - data of the calling thread
+ * src - input values array
+ * hist - histograms of every digit (2^width bit intervals of each digit, one after another)
+ * bitCount - maximal number of sorted bits in one iteration
+ * countingBits - maximal number of bits of the range of keys sorted by counting sort (0 - no counting sort)
+ * plan - output, shared plan of passes
+ */
+template<class Ti, class Tc>
+int planPasses(RsortData<Ti,Tc> *datas, RsortData<Ti,Tc> &mydata, const Ti *src, Tc *hist, int bitCount, int countingBits,
+		PassPlan<Ti,Tc> &plan, LVTimer *timers)
+{
+	typedef typename RadixTraits<Ti>::Key Key;
+
+        if(timers!=NULL)
+            timers->timerStart(1);
+
+#pragma omp single
+	{
+		plan.count = uniformDigits<Ti>(plan.digits, bitCount);
+		plan.offset = Key();
+	}
+	countHistograms(datas, mydata, src, hist, plan.digits, plan.count, plan.offset, plan.min, plan.max, plan.descents);
+#pragma omp single
+	{
+		plan.passes = planDigits(hist, plan.digits, plan.count, plan.plan);
+		plan.rangeBits = KeyRange<Key>::digits(plan.min, plan.max, 1);
+		plan.reduced = KeyRange<Key>::digits(plan.min, plan.max, bitCount) < plan.passes
+				&& !useCountingSort(plan.passes, plan.rangeBits, countingBits);
+		if (plan.reduced)
+			plan.offset = plan.min;
+	}
+
+	// range reduction
+	if (plan.reduced) {
+		countHistograms(datas, mydata, src, hist, plan.digits, plan.count, plan.offset, plan.min, plan.max, plan.descents);
+#pragma omp single
+		plan.passes = planDigits(hist, plan.digits, plan.count, plan.plan);
+	}
+
+	// digits of nearly equal width (no more of them than passes, each at most bitCount bits,
+	// so their histograms fit in the space of uniform digits; the cost model knows digits of up to TUNE_BITS bits)
+#pragma omp single
+	{
+		int const passes = plan.passes;
+		plan.balanced = 0;
+		if (passes > 1 && bitCount <= TUNE_BITS && !useCountingSort(passes, plan.rangeBits, countingBits)) {
+			const TuneModel &model = tuneCache().model(sizeof(Ti));
+			int const low = plan.plan[0].shift;
+			int const high = plan.plan[passes - 1].shift + plan.plan[passes - 1].width;
+			double planned = 0;
+			for (int p = 0; p < passes; p++)
+				planned += model.single[plan.plan[p].width];
+			// counting reads values once, without moving them
+			double best = planned - 0.5 * model.single[4];
+			for (int p = (high - low + bitCount - 1) / bitCount; p <= passes; p++) {
+				double cost = 0;
+				for (int d = 0; d < p; d++)
+					cost += model.single[low + (high - low) * (d + 1) / p - low - (high - low) * d / p];
+				if (cost < best) {
+					best = cost;
+					plan.balanced = p;
+				}
+			}
+			if (plan.balanced > 0)
+				balancedDigits(plan.digits, low, high, plan.balanced);
+		}
+	}
+	if (plan.balanced > 0) {
+		countHistograms(datas, mydata, src, hist, plan.digits, plan.balanced, plan.offset, plan.min, plan.max, plan.descents);
+#pragma omp single
+		plan.passes = planDigits(hist, plan.digits, plan.balanced, plan.plan);
+	}
+
+        if(timers!=NULL)
+            timers->timerEnd(1);
+
+	return plan.passes;
+}
+
+/* Reversing values (and keys) sorted in reverse
+ * (run by every thread of the parallel region of sorting)
+ *
+ * src - values array
+ * key - keys array (NULL if keys are not moved)
+ * N - number of values
+ */
+template<class Ti, class Tk, class Tc>
+void reverseValues(Ti *src, Tk *key, Tc N) {
+#pragma omp for
+	for (Tc i = 0; i < N / 2; i++) {
+		swap(src[i], src[N - 1 - i]);
+		if (key != NULL)
+			swap(key[i], key[N - 1 - i]);
+	}
+}
+
+/* Sorted runs of values recognized by countHistograms
+ * (returns the number of runs, or MERGE_RUNS + 1 when there are more of them)
+ *
+ * t - number of threads
+ * datas - threads data
+ * N - number of values
+ * descents - number of values smaller than their predecessor
+ * bounds - output, runs + 1 indices from which runs begin (the last one is N)
+ */
+template<class Ti, class Tc>
+int sortedRuns(int t, const RsortData<Ti,Tc> *datas, Tc N, Tc descents, Tc *bounds) {
+	if (descents >= MERGE_RUNS)
+		return MERGE_RUNS + 1;
+	int runs = 0;
+	bounds[runs++] = 0;
+	for (int i = 0; i < t; i++)
+		for (Tc d = 0; d < datas[i].descents; d++)
+			bounds[runs++] = datas[i].runs[d];
+	bounds[runs] = N;
+	return runs;
+}
+
+/* Checking if runs are merged instead of sorted by radix passes
+ * (merging reads and writes values in each round like a pass, and each round halves the number of runs)
+ *
+ * runs - number of sorted runs
+ * passes - number of radix passes
+ */
+inline bool useMerging(int runs, int passes) {
+	if (runs > MERGE_RUNS)
+		return false;
+	int rounds = 0;
+	while ((1 << rounds) < runs)
+		rounds++;
+	return rounds < passes;
+}
+
+/* Index in a of the first value which is not among the first d values of merged arrays a and b
+ * (values of a are placed before equal values of b, so merging is stable)
+ *
+ * a, b - sorted arrays
+ * na, nb - numbers of values of a and b
+ * d - number of merged values
+ */
+template<class Ti, class Tc>
+Tc mergeSplit(const Ti *a, Tc na, const Ti *b, Tc nb, Tc d) {
+	Tc low = d > nb ? d - nb : 0;
+	Tc high = d < na ? d : na;
+	while (low < high) {
+		Tc middle = low + (high - low) / 2;
+		if (RadixTraits<Ti>::key(b[d - middle - 1]) < RadixTraits<Ti>::key(a[middle]))
+			high = middle;
+		else
+			low = middle + 1;
+	}
+	return low;
+}
+
+/* One round of merging - pairs of neighbouring sorted runs are merged into the other array
+ * (returns the number of runs after the round, bounds of runs are updated)
+ *
+ * Each thread writes an equal part of output array, it finds where its part begins
+ * in merged runs by binary search (see mergeSplit). Run by every thread of the parallel
+ * region of sorting, bounds are updated by one thread when all threads have merged their parts.
+ *
+ * src - input values array
+ * dest - output values array
+ * src_key - input keys array (NULL if keys are indices of values in src or are not moved)
+ * dest_key - output keys array (NULL if keys are not moved)
+ * N - number of values
+ * bounds - runs + 1 indices from which runs begin (the last one is N)
+ * runs - number of runs
+ */
+template<class Ti, class Tk, class Tc>
+int mergeRound(const Ti *src, Ti *dest, const Tk *src_key, Tk *dest_key, Tc N, Tc *bounds, int runs) {
+	int id = omp_get_thread_num();
+	int t = omp_get_num_threads();
+	Tc first = (Tc) ((size_t) N * id / t);
+	Tc last = (Tc) ((size_t) N * (id + 1) / t);
+	for (int r = 0; r < runs; r += 2) {
+		// the last run without a pair is merged with an empty run
+		Tc begin = bounds[r];
+		Tc middle = bounds[r + 1];
+		Tc end = r + 2 <= runs ? bounds[r + 2] : middle;
+		Tc from = first > begin ? first : begin;
+		Tc to = last < end ? last : end;
+		if (from >= to)
+			continue;
+
+		const Ti *a = src + begin;
+		const Ti *b = src + middle;
+		Tc na = middle - begin;
+		Tc nb = end - middle;
+		Tc i = mergeSplit(a, na, b, nb, from - begin);
+		Tc j = from - begin - i;
+		for (Tc position = from; position < to; position++) {
+			bool second = j < nb && (i >= na || RadixTraits<Ti>::key(b[j]) < RadixTraits<Ti>::key(a[i]));
+			Tc index = second ? middle + j : begin + i;
+			dest[position] = src[index];
+			if (dest_key != NULL)
+				dest_key[position] = src_key != NULL ? src_key[index] : (Tk) index;
+			i += !second;
+			j += second;
+		}
+	}
+#pragma omp barrier
+	int merged = (runs + 1) / 2;
+#pragma omp single
+	{
+		for (int r = 0; r < runs; r += 2)
+			bounds[r / 2] = bounds[r];
+		bounds[merged] = N;
+	}
+	return merged;
+}
+
+/* Proper radix sorting
+ *
+ * All phases of sorting run in one parallel region: they are separated by barriers, decisions
+ * shared by threads are made by one thread (see PassPlan), and each thread keeps its own data
+ * in mydata during the whole sort. Timers are given only to the master thread.
+ *
+ * src - input values array
+ * temp - temporary values array
+ * key - input keys array (NULL if only values are sorted)
+ * temp_key - temporary keys array
+ * datas - threads data
+ * t - number of threads (all parallel regions of sorting run with t threads)
+ * N - number of values
+ * bitCount - maximal number of sorted bits in one iteration
+ * work - work space of digits x bitIntervals + max(2^COUNTING_SORT_BITS, 2 x t x bitIntervals + t) counters
+ * buffered - values are inserted through write combining buffers of threads
+ */
+template<class Ti,class Tk, class Tc>
+void RSB(Ti* src, Ti * temp,Tk *key,Tk *temp_key, RsortData<Ti,Tc> * datas, int t, const Tc N, int bitCount, Tc *work, bool buffered, LVTimer *timers )
+{
+        int const bitIntervals = 1<<bitCount;
+
+	//histograms of every digit (row of digit holds the number of values of each of its bit intervals)
+	Tc *hist = work;
+
+	// work space of starting indices of passes (or of counting sort, which replaces passes)
+	Tc *scan = hist + datas->digits * bitIntervals;
+
+	// integers without keys are known from their keys, so they can be filled from histograms
+	// (scattering keys with 2^COUNTING_SORT_BITS bit intervals is slower than radix passes)
+	int const countingBits = key == NULL && is_integral<Ti>::value ? COUNTING_SORT_BITS : 0;
+
+	// pass plan - digits which take more than one value
+	PassPlan<Ti,Tc> plan;
+
+#pragma omp parallel num_threads(t)
+	{
+		int id = omp_get_thread_num();
+
+		RsortData<Ti,Tc> mydata = datas[id];
+		LVTimer *mytimers = id == 0 ? timers : NULL;
+
+		Ti * t1 = src;
+		Ti * t2 = temp;
+
+		Tk * k1 = key;
+		Tk * k2 = key != NULL ? temp_key : NULL;
+
+		// counting histograms of every digit
+		int passes = planPasses(datas, mydata, t1, hist, bitCount, countingBits, plan, mytimers);
+
+		// presorted values: values sorted in reverse are reversed, sorted values stay where they are
+		// and a few sorted runs are merged (see countHistograms)
+		if (passes > 0 && plan.descents == N - 1) {
+			reverseValues(src, key, N);
+			passes = 0;
+		} else if (passes > 0) {
+#pragma omp single
+			plan.runs = sortedRuns(t, datas, N, plan.descents, plan.bounds);
+			if (useMerging(plan.runs, passes)) {
+				int runs = plan.runs;
+				while (runs > 1) {
+					runs = mergeRound(t1, t2, k1, k2, N, plan.bounds, runs);
+					Ti * iswap = t1;
+					t1 = t2;
+					t2 = iswap;
+					Tk* kswap = k1;
+					k1 = k2;
+					k2 = kswap;
+				}
+				passes = 0;
+			}
+		}
+
+		// values which differ in one digit are filled from its histogram
+		if (countingBits > 0 && passes == 1) {
+			fillValues(mydata, src, hist + plan.plan[0].row, 1 << plan.plan[0].width, plan.offset, plan.min, plan.plan[0].shift);
+			passes = 0;
+		}
+
+		// short range of keys
+		if (useCountingSort(passes, plan.rangeBits, countingBits)) {
+			countingSort(datas, mydata, src, scan, plan.rangeBits, plan.min, mytimers);
+			passes = 0;
+		}
+
+		//main loop
+		for (int pass = 0; pass < passes; pass++) {
+
+			radixPass(datas, mydata, t, t1, t2, k1, k2, scan, plan.plan, pass, passes, buffered, plan.offset, mytimers);
+
+			// Changing arrays
+			Ti * iswap;
+			iswap = t1;
+			t1 = t2;
+			t2 = iswap;
+			Tk* kswap = k1;
+			k1=k2;
+			k2= kswap;
+
+		}
+
+		// without keys there is no permutation to determine
+		if (key != NULL) {
+			determineKey(k1,k2,mydata);
+#pragma omp barrier
+		}
+
+// Copy array values into src array in case startSrc!=src
+	        if(mytimers!=NULL)
+		    mytimers->timerStart(5);
+
+		if (src != t1)
+			copyArray(mydata, src, t1);
+		if (key != NULL && key!= k2)
+			rewriteKeys(key,k2,mydata);
+
+	        if(timers!=NULL)
+	        {
+#pragma omp barrier
+	            if(mytimers!=NULL)
+	 	        mytimers->timerEnd(5);
+	        }
+	}
+
+        if(timers!=NULL)
+	    for (int i = 2; i < 5; i++)
+		timers->finish(i);
+
+}
+
+/* Radix sorting which determines only the sorting permutation (argsort)
+ *
+ * Values of src are read only in the first pass, next passes move values
+ * and their indices between temporary arrays. Indices of the first pass are
+ * positions in src, so keys of the last pass are already the permutation.
+ *
+ * src - input values array (not modified)
+ * temp - temporary values array
+ * temp2 - second temporary values array
+ * perm - output permutation (perm[i] - index in src of the i-th smallest value)
+ * temp_key - temporary keys array
+ * datas - threads data
+ * t - number of threads (all parallel regions of sorting run with t threads)
+ * N - number of values
+ * bitCount - maximal number of sorted bits in one iteration
+ * work - work space of digits x bitIntervals + 2 x t x bitIntervals + t counters
+ * buffered - values are inserted through write combining buffers of threads
+ */
+template<class Ti,class Tk, class Tc>
+void RSBArgsort(const Ti* src, Ti * temp, Ti * temp2, Tk *perm, Tk *temp_key, RsortData<Ti,Tc> * datas, int t, const Tc N, int bitCount, Tc *work, bool buffered, LVTimer *timers )
+{
+	Tc *hist = work;
+	Tc *scan = hist + datas->digits * (1 << bitCount);
+	PassPlan<Ti,Tc> plan;
+
+#pragma omp parallel num_threads(t)
+	{
+		int id = omp_get_thread_num();
+
+		RsortData<Ti,Tc> mydata = datas[id];
+		LVTimer *mytimers = id == 0 ? timers : NULL;
+		int passes = planPasses(datas, mydata, src, hist, bitCount, 0, plan, mytimers);
+
+		if (passes == 0 || plan.descents == 0) {
+			// all values are equal or sorted, values keep their positions
+			for (Tc i = 0; i < mydata.N; i++)
+				perm[mydata.start_i + i] = (Tk) (mydata.start_i + i);
+		} else if (plan.descents == N - 1) {
+			// values sorted in reverse
+			for (Tc i = 0; i < mydata.N; i++)
+				perm[mydata.start_i + i] = (Tk) (N - 1 - mydata.start_i - i);
+		} else {
+			// a few sorted runs are merged like passes: the first round reads src,
+			// next rounds alternate between temporary arrays (see RSB)
+#pragma omp single
+			plan.runs = sortedRuns(t, datas, N, plan.descents, plan.bounds);
+			int runs = plan.runs;
+			bool merged = useMerging(runs, passes);
+			if (merged) {
+				int rounds = 0;
+				while ((1 << rounds) < runs)
+					rounds++;
+				passes = rounds;
+			}
+
+			// keys arrays alternate so that the last pass (or round) writes into perm
+			Tk * k1 = (passes % 2 == 1) ? perm : temp_key;
+			Tk * k2 = (passes % 2 == 1) ? temp_key : perm;
+			if (merged)
+				runs = mergeRound(src, temp, (Tk *) NULL, k1, N, plan.bounds, runs);
+			else
+				radixPass(datas, mydata, t, src, temp, (Tk *) NULL, k1, scan, plan.plan, 0, passes, buffered, plan.offset, mytimers);
+
+			Ti * t1 = temp;
+			Ti * t2 = temp2;
+			for (int pass = 1; pass < passes; pass++) {
+
+				if (merged)
+					runs = mergeRound(t1, t2, k1, k2, N, plan.bounds, runs);
+				else
+					radixPass(datas, mydata, t, t1, t2, k1, k2, scan, plan.plan, pass, passes, buffered, plan.offset, mytimers);
+
+				Ti * iswap = t1;
+				t1 = t2;
+				t2 = iswap;
+				Tk* kswap = k1;
+				k1=k2;
+				k2= kswap;
+			}
+		}
+	}
+
+        if(timers!=NULL)
+	    for (int i = 2; i < 5; i++)
+		timers->finish(i);
+
+}
+
+/* Swapping values and keys
+ *
+ * src - values array
+ * key - keys array
+ * i - index of the first value
+ * value - second value
+ * value_key - key of the second value
+ */
+template<class Ti, class Tk, class Tc>
+inline void swapValues(Ti *src, Tk *key, Tc i, Ti &value, Tk &value_key) {
+	Ti value_swap = src[i];
+	Tk key_swap = key[i];
+	src[i] = value;
+	key[i] = value_key;
+	value = value_swap;
+	value_key = key_swap;
+}
+
+/* Sorting a short part of array by insertion (stable)
+ *
+ * src - values array
+ * key - keys array (NULL if keys are not moved)
+ * N - number of values
+ *
+ * Values are compared by their radix keys (see RadixTraits).
+ */
+template<class Ti, class Tk>
+void insertionSort(Ti *src, Tk *key, int N) {
+	for (int i = 1; i < N; i++) {
+		Ti value = src[i];
+		Tk value_key = key != NULL ? key[i] : Tk();
+		int j = i;
+		for (; j > 0 && RadixTraits<Ti>::key(value) < RadixTraits<Ti>::key(src[j - 1]); j--) {
+			src[j] = src[j - 1];
+			if (key != NULL)
+				key[j] = key[j - 1];
+		}
+		src[j] = value;
+		if (key != NULL)
+			key[j] = value_key;
+	}
+}
+
+#define INSERTION_SORT_LIMIT 64 // parts of array shorter than this are sorted by insertion
+
+/* In-place sorting of a part of array by a single thread (American flag sort)
+ *
+ * src - values array
+ * key - keys array
+ * N - number of values
+ * plan - digits which take more than one value
+ * pass - index of the sorted digit in plan, lower digits of plan are sorted recursively
+ * bitCount - maximal number of bits in one digit
+ * counts - work space of 2 x 2^bitCount counters for each pass
+ * offset - key subtracted from keys of values
+ */
+template<class Ti, class Tk, class Tc>
+void sortPartInPlace(Ti *src, Tk *key, Tc N, const Digit *plan, int pass, int bitCount, Tc *counts,
+		const typename RadixTraits<Ti>::Key &offset) {
+	if (N < INSERTION_SORT_LIMIT) {
+		insertionSort(src, key, (int) N);
+		return;
+	}
+	int const bitIntervals = 1 << plan[pass].width;
+	int const iterator = plan[pass].shift;
+	Tc *head = counts;
+	Tc *tail = counts + bitIntervals;
+
+	for (int i = 0; i < bitIntervals; i++)
+		tail[i] = 0;
+	for (Tc i = 0; i < N; i++)
+		tail[digitOf(src[i], iterator, bitIntervals, offset)]++;
+	Tc sum = 0;
+	for (int i = 0; i < bitIntervals; i++) {
+		head[i] = sum;
+		sum += tail[i];
+		tail[i] = sum;
+	}
+
+	// moving values along cycles until each bit interval is filled
+	for (int i = 0; i < bitIntervals; i++) {
+		while (head[i] < tail[i]) {
+			Ti value = src[head[i]];
+			Tk value_key = key[head[i]];
+			int index = digitOf(value, iterator, bitIntervals, offset);
+			while (index != i) {
+				swapValues(src, key, head[index]++, value, value_key);
+				index = digitOf(value, iterator, bitIntervals, offset);
+			}
+			src[head[i]] = value;
+			key[head[i]++] = value_key;
+		}
+	}
+
+	if (pass == 0)
+		return;
+	Tc begin = 0;
+	for (int i = 0; i < bitIntervals; i++) {
+		if (tail[i] - begin > 1)
+			sortPartInPlace(src + begin, key + begin, tail[i] - begin, plan, pass - 1, bitCount, counts + (2 << bitCount), offset);
+		begin = tail[i];
+	}
+}
+
+/* In-place parallel partitioning of a part of array into bit intervals (PARADIS scheme)
+ *
+ * Each round splits not yet placed part of every bit interval into stripes of threads.
+ * Threads move values between their own stripes, then values left in wrong bit intervals
+ * are gathered at the end of each bit interval for the next round.
+ *
+ * src - values array
+ * key - keys array
+ * N - number of values
+ * iterator - number of bits for which value is needed to be moved
+ * bitIntervals - number of bit intervals
+ * t - number of threads
+ * bounds - output, bitIntervals + 1 indices from which each bit interval begins
+ * heads - work space of 2 x t x bitIntervals counters
+ * tails - work space of 2 x bitIntervals counters
+ * offset - key subtracted from keys of values
+ */
+template<class Ti, class Tk, class Tc>
+void partitionInPlace(Ti *src, Tk *key, Tc N, int iterator, int bitIntervals, int t, Tc *bounds, Tc *heads, Tc *tails,
+		const typename RadixTraits<Ti>::Key &offset) {
+	Tc *stripe_heads = heads;
+	Tc *stripe_tails = heads + t * bitIntervals;
+	Tc *start_higher = tails;
+	Tc *end_higher = tails + bitIntervals;
+
+	// counting the number of values of each bit interval
+#pragma omp parallel num_threads(t)
+	{
+		int id = omp_get_thread_num();
+		Tc *bits = stripe_heads + id * bitIntervals;
+		for (int i = 0; i < bitIntervals; i++)
+			bits[i] = 0;
+		Tc end = (Tc) ((long long) N * (id + 1) / t);
+		for (Tc i = (Tc) ((long long) N * id / t); i < end; i++)
+			bits[digitOf(src[i], iterator, bitIntervals, offset)]++;
+	}
+	bounds[0] = 0;
+	for (int i = 0; i < bitIntervals; i++) {
+		Tc sum = 0;
+		for (int j = 0; j < t; j++)
+			sum += stripe_heads[j * bitIntervals + i];
+		bounds[i + 1] = bounds[i] + sum;
+		start_higher[i] = bounds[i];
+		end_higher[i] = bounds[i + 1];
+	}
+
+	Tc left = N;
+	int stripes = t;
+	while (left > 0) {
+		// stripes of threads
+		for (int j = 0; j < stripes; j++)
+			for (int i = 0; i < bitIntervals; i++) {
+				long long length = end_higher[i] - start_higher[i];
+				stripe_heads[j * bitIntervals + i] = start_higher[i] + (Tc) (length * j / stripes);
+				stripe_tails[j * bitIntervals + i] = start_higher[i] + (Tc) (length * (j + 1) / stripes);
+			}
+
+		// moving values between stripes of a thread
+#pragma omp parallel for num_threads(stripes)
+		for (int j = 0; j < stripes; j++) {
+			Tc *head = stripe_heads + j * bitIntervals;
+			Tc *tail = stripe_tails + j * bitIntervals;
+			for (int i = 0; i < bitIntervals; i++) {
+				for (Tc position = head[i]; position < tail[i]; position++) {
+					Ti value = src[position];
+					Tk value_key = key[position];
+					int index = digitOf(value, iterator, bitIntervals, offset);
+					while (index != i && head[index] < tail[index]) {
+						swapValues(src, key, head[index]++, value, value_key);
+						index = digitOf(value, iterator, bitIntervals, offset);
+					}
+					if (index == i) {
+						src[position] = src[head[i]];
+						key[position] = key[head[i]];
+						src[head[i]] = value;
+						key[head[i]++] = value_key;
+					} else {
+						src[position] = value;
+						key[position] = value_key;
+					}
+				}
+			}
+		}
+
+		// gathering values of wrong bit intervals at the end of each bit interval
+		Tc placed = 0;
+#pragma omp parallel for schedule(dynamic) reduction(+:placed) num_threads(t)
+		for (int i = 0; i < bitIntervals; i++) {
+			Tc wrong = 0;
+			for (int j = 0; j < stripes; j++)
+				for (Tc position = stripe_heads[j * bitIntervals + i]; position < stripe_tails[j * bitIntervals + i]; position++)
+					wrong += digitOf(src[position], iterator, bitIntervals, offset) != i;
+			Tc end = end_higher[i] - wrong;
+			Tc last = end_higher[i];
+			for (int j = 0; j < stripes; j++) {
+				Tc stop = stripe_tails[j * bitIntervals + i] < end ? stripe_tails[j * bitIntervals + i] : end;
+				for (Tc position = stripe_heads[j * bitIntervals + i]; position < stop; position++) {
+					if (digitOf(src[position], iterator, bitIntervals, offset) == i)
+						continue;
+					do
+						last--;
+					while (digitOf(src[last], iterator, bitIntervals, offset) != i);
+					Ti value = src[last];
+					Tk value_key = key[last];
+					swapValues(src, key, position, value, value_key);
+					src[last] = value;
+					key[last] = value_key;
+				}
+			}
+			placed += end - start_higher[i];
+			start_higher[i] = end;
+		}
+
+		// a single stripe places all remaining values, it is used when threads stop making progress
+		stripes = (placed * 2 < left) ? 1 : t;
+		left -= placed;
+	}
+}
+
+/* In-place sorting of a part of array with all threads
+ *
+ * src - values array
+ * key - keys array
+ * N - number of values
+ * plan - digits which take more than one value
+ * pass - index of the sorted digit in plan, lower digits of plan are sorted recursively
+ * bitCount - maximal number of bits in one digit
+ * t - number of threads
+ * large - parts of array at least that long are partitioned with all threads
+ * bounds - work space of 2^bitCount + 1 counters for each pass
+ * heads, tails - work space of partitionInPlace
+ * counts - work space of sortPartInPlace for each thread
+ * offset - key subtracted from keys of values
+ */
+template<class Ti, class Tk, class Tc>
+void sortInPlace(Ti *src, Tk *key, Tc N, const Digit *plan, int pass, int bitCount, int t, Tc large,
+		Tc *bounds, Tc *heads, Tc *tails, Tc *counts, const typename RadixTraits<Ti>::Key &offset) {
+	int const bitIntervals = 1 << plan[pass].width;
+	Tc *bound = bounds + pass * ((1 << bitCount) + 1);
+	partitionInPlace(src, key, N, plan[pass].shift, bitIntervals, t, bound, heads, tails, offset);
+	if (pass == 0)
+		return;
+
+	for (int i = 0; i < bitIntervals; i++)
+		if (bound[i + 1] - bound[i] >= large)
+			sortInPlace(src + bound[i], key + bound[i], bound[i + 1] - bound[i], plan, pass - 1, bitCount, t, large,
+					bounds, heads, tails, counts, offset);
+
+#pragma omp parallel for schedule(dynamic) num_threads(t)
+	for (int i = 0; i < bitIntervals; i++) {
+		Tc length = bound[i + 1] - bound[i];
+		if (length > 1 && length < large)
+			sortPartInPlace(src + bound[i], key + bound[i], length, plan, pass - 1, bitCount,
+					counts + omp_get_thread_num() * pass * (2 << bitCount), offset);
+	}
+}
+
+/* Turning keys of sorted values into keys of input values, in place
+ * (key[i] is the input index of the i-th sorted value, after computations
+ * key[j] is the location of the j-th input value)
+ *
+ * Each thread walks cycles of the permutation from indices of its part of keys, INVERT_WALKS of them together.
+ * An index of a walk is claimed by setting the highest bit of its key (indices never use it, see checkLength)
+ * in the same atomic operation which reads the key, the next index of the walk, and the key of the next index
+ * is replaced by the index. A walk stops at an index claimed before (by another walk or by its own start),
+ * so cycles are split between walks and every key is read and replaced exactly once.
+ *
+ * key - keys array
+ * N - number of values
+ * t - number of threads
+ */
+template<class Tk, class Tc>
+void invertKeysInPlace(Tk *key, Tc N, int t) {
+	Tk const claimed = (Tk) ((typename make_unsigned<Tk>::type) 1 << (8 * sizeof(Tk) - 1));
+#pragma omp parallel num_threads(t) if (t > 1)
+	{
+		int const id = omp_get_thread_num();
+		Tc i = (Tc) ((long long) N * id / t);
+		Tc const end = (Tc) ((long long) N * (id + 1) / t);
+		// index reached by each walk and the next index of the walk (the old key of the index)
+		Tk position[INVERT_WALKS];
+		Tk next[INVERT_WALKS];
+		int walks = 0;
+		for (;;) {
+			// walks are started from indices not claimed yet (they are skipped without a locked operation)
+			while (walks < INVERT_WALKS && i < end) {
+				Tk old;
+#pragma omp atomic read
+				old = key[i];
+				if (!(old & claimed)) {
+#pragma omp atomic capture
+					{ old = key[i]; key[i] |= claimed; }
+					if (!(old & claimed)) {
+						position[walks] = (Tk) i;
+						next[walks++] = old;
+						prefetch(key + old);
+					}
+				}
+				i++;
+			}
+			if (walks == 0)
+				break;
+			for (int w = 0; w < walks; ) {
+				Tk const target = next[w];
+				Tk old;
+#pragma omp atomic capture
+				{ old = key[target]; key[target] |= claimed; }
+#pragma omp atomic write
+				key[target] = (Tk) (position[w] | claimed);
+				if (old & claimed) {
+					// the last walk takes the place of the finished one
+					walks--;
+					position[w] = position[walks];
+					next[w] = next[walks];
+				} else {
+					position[w] = target;
+					next[w] = old;
+					prefetch(key + old);
+					w++;
+				}
+			}
+		}
+	}
+#pragma omp parallel for num_threads(t) if (t > 1)
+	for (Tc i = 0; i < N; i++)
+		key[i] &= ~claimed;
+}
+
+/* Proper in-place radix sorting (most significant digit first)
+ *
+ * src - input values array
+ * key - input keys array
+ * datas - threads data
+ * t - number of threads (all parallel regions of sorting run with t threads)
+ * N - number of values
+ * bitCount - maximal number of sorted bits in one iteration
+ * work - work space of digits x (2 x (t + 1) x bitIntervals + 1) + 2 x (t + 1) x bitIntervals counters
+ */
+template<class Ti,class Tk, class Tc>
+void RSBInPlace(Ti* src, Tk *key, RsortData<Ti,Tc> * datas, int t, const Tc N, int bitCount, Tc *work, LVTimer *timers )
+{
+	int const bitIntervals = 1<<bitCount;
+
+	// counting histograms of every digit
+	PassPlan<Ti,Tc> plan;
+	Tc *hist = work;
+	int passes = 0;
+#pragma omp parallel num_threads(t)
+	{
+		int id = omp_get_thread_num();
+		RsortData<Ti,Tc> mydata = datas[id];
+		int planned = planPasses(datas, mydata, src, hist, bitCount, 0, plan, id == 0 ? timers : NULL);
+
+		// presorted values (runs are not merged, it would need a temporary array)
+		if (planned > 0 && plan.descents == N - 1)
+			reverseValues(src, key, N);
+		if (id == 0)
+			passes = plan.descents == 0 || plan.descents == N - 1 ? 0 : planned;
+	}
+
+        if(timers!=NULL)
+            timers->timerStart(4);
+
+	if (passes > 0) {
+		// bounds of bit intervals for each pass, stripes of threads, work space of each thread
+		// (histograms are not needed any more)
+		Tc *bounds = hist;
+		Tc *heads = bounds + passes * (bitIntervals + 1);
+		Tc *tails = heads + 2 * t * bitIntervals;
+		Tc *counts = tails + 2 * bitIntervals;
+
+		// parts of array sorted with all threads, remaining parts are sorted by single threads
+		Tc large = N / (2 * t) > (1 << 16) ? N / (2 * t) : (1 << 16);
+		sortInPlace(src, key, N, plan.plan, passes - 1, bitCount, t, large, bounds, heads, tails, counts, plan.offset);
+	}
+
+        if(timers!=NULL)
+        {
+            timers->timerEnd(4);
+            timers->timerStart(5);
+        }
+
+	invertKeysInPlace(key, N, t);
+
+        if(timers!=NULL)
+            timers->timerEnd(5);
+}
+
+/* Counting histograms of 8-bit digits and planning passes by the calling thread
+ * (returns the number of passes, see planPasses)
+ *
+ * src - values array
+ * N - number of values
+ * hist - work space of 256 x sizeof(Ti) counters, output, histograms of every digit
+ * plan - output, digits sorted in passes
+ */
+template<class Ti, class Tc>
+int planSequential(const Ti *src, Tc N, Tc *hist, Digit *plan) {
+	typedef typename RadixTraits<Ti>::Key Key;
+	Digit digits[8 * sizeof(Ti)];
+	int count = uniformDigits<Ti>(digits, 8);
+	int const size = digits[count - 1].row + (1 << digits[count - 1].width);
+	for (int i = 0; i < size; i++)
+		hist[i] = 0;
+	for (Tc i = 0; i < N; i++)
+		for (int d = 0; d < count; d++)
+			hist[digits[d].row + digitOf(src[i], digits[d].shift, 1 << digits[d].width, Key())]++;
+	return planDigits(hist, digits, count, plan);
+}
+
+/* Radix sorting of a short array by the calling thread, without parallel regions
+ * (arrays shorter than INSERTION_SORT_LIMIT are sorted by insertion, longer ones
+ * by passes of 8-bit digits, stable in both cases)
+ *
+ * Keys are moved together with values, they are not inverted (see determineKey).
+ *
+ * src - input values array, after sorting it holds sorted values
+ * temp - temporary values array
+ * key - input keys array, after sorting it holds keys of sorted values (NULL if only values are sorted)
+ * temp_key - temporary keys array
+ * N - number of values
+ * work - work space of 256 x sizeof(Ti) counters
+ */
+template<class Ti,class Tk, class Tc>
+void radixSortSequential(Ti *src, Ti *temp, Tk *key, Tk *temp_key, const Tc N, Tc *work)
+{
+	if (N < INSERTION_SORT_LIMIT) {
+		insertionSort(src, key, (int) N);
+		return;
+	}
+
+	Tc *hist = work;
+	Digit plan[8 * sizeof(Ti)];
+	int passes = planSequential(src, N, hist, plan);
+
+	Ti * t1 = src;
+	Ti * t2 = temp;
+	Tk * k1 = key;
+	Tk * k2 = key != NULL ? temp_key : NULL;
+	for (int pass = 0; pass < passes; pass++) {
+		int const bitIntervals = 1 << plan[pass].width;
+		int const iterator = plan[pass].shift;
+
+		// histogram of the digit turned into starting indices of its bit intervals
+		Tc *start = hist + plan[pass].row;
+		Tc sum = 0;
+		for (int i = 0; i < bitIntervals; i++) {
+			Tc count = start[i];
+			start[i] = sum;
+			sum += count;
+		}
+
+		for (Tc i = 0; i < N; i++) {
+			Tc position = start[digitOf(t1[i], iterator, bitIntervals, typename RadixTraits<Ti>::Key())]++;
+			t2[position] = t1[i];
+			if (k1 != NULL)
+				k2[position] = k1[i];
+		}
+
+		Ti * iswap = t1;
+		t1 = t2;
+		t2 = iswap;
+		Tk* kswap = k1;
+		k1 = k2;
+		k2 = kswap;
+	}
 
- 
-#pragma omp barrier
+	if (t1 != src) {
+		for (Tc i = 0; i < N; i++)
+			src[i] = t1[i];
+		if (key != NULL)
+			for (Tc i = 0; i < N; i++)
+				key[i] = k1[i];
+	}
+}
 
-		// Calculating starting indices for each bits interval
-		calculateStartingIndices<Ti>( t, datas, start_higher, 0,bitIntervals);
+/* In-place radix sorting of a short array by the calling thread, without parallel regions
+ * (most significant digit first by sortPartInPlace, then keys are inverted like in RSBInPlace)
+ *
+ * src - values array
+ * key - keys array
+ * N - number of values
+ * work - work space of 2 x 256 x sizeof(Ti) counters
+ */
+template<class Ti,class Tk, class Tc>
+void sortInPlaceSequential(Ti *src, Tk *key, const Tc N, Tc *work)
+{
+	Digit plan[8 * sizeof(Ti)];
+	int passes = N < INSERTION_SORT_LIMIT ? 0 : planSequential(src, N, work, plan);
+	if (passes > 0)
+		// histograms are not needed any more, counters of passes take their place
+		sortPartInPlace(src, key, N, plan, passes - 1, 8, work, typename RadixTraits<Ti>::Key());
+	else
+		insertionSort(src, key, (int) N);
+	invertKeysInPlace(key, N, 1);
+}
 
-            if(timers!=NULL)
-            {
-	        timers->add(3);
-		timers->timerStart(4);
-	    }
+// Sorter keeps threads data, work space and temporary arrays between calls.
+// They are allocated (and temporary arrays are first touched) only when more values,
+// a longer digit or more threads are needed than in previous calls,
+// so sorting many arrays of similar size does not allocate memory.
+// Numbers of values are counted with counters as wide as keys (see RsortCounter),
+// so more than 2^31 values need 64-bit keys (e.g. Sorter<int,long long>).
+// bitCount 0 chooses the digit width and the number of threads by the cost model (see TuneModel).
+// Short arrays are sorted by fewer threads, the shortest ones by the calling thread alone
+// with 8-bit digits whatever bitCount is (see THREAD_VALUES).
+//
+template <class Ti, class Tk = int>
+class Sorter{
 
+public:
+    Sorter(const Policy &policy = Policy());
+    ~Sorter();
 
-		// Inserting values into output array
-	    insertValues(datas, t1, t2,k1,k2, iterator,N,t,bitIntervals);
-            if(timers!=NULL)
-    	        timers->add(4);
-    
+    //Changes placement policy of threads and temporary arrays allocated from now on
+    void setPolicy(const Policy &policy);
 
-		// Changing checked bits
-		max = max>>bitCount;
-		Ti * iswap;
-		iswap = t1;
-		t1 = t2;
-		t2 = iswap;
-		Tk* kswap = k1;
-		k1=k2;
-		k2= kswap;
+    //Allocates and first touches work space for N values sorted with bitCount bits
+    //in one iteration by the current number of threads
+    void reserve(size_t N, int bitCount);
 
-		iterator += bitCount;
+    //Sorts values and determines keys like pradsort
+    void sort(Ti *src, Tk *key, const size_t N, int bitCount, LVTimer *timers);
 
-	}
+    //Sorts only values, no keys are moved and no temporary keys array is allocated
+    void sort(Ti *src, const size_t N, int bitCount, LVTimer *timers);
 
-	determineKey(k1,k2,datas,N);
+    //Determines the sorting permutation like pradargsort, src is not modified
+    void argsort(const Ti *src, Tk *perm, const size_t N, int bitCount, LVTimer *timers);
 
-// Copy array values into src array in case startSrc!=src
-        if(timers!=NULL)
-	    timers->timerStart(5);
+    //Sorts values in place and determines keys like pradsortInPlace
+    void sortInPlace(Ti *src, Tk *key, const size_t N, int bitCount, LVTimer *timers);
 
-	if (src != t1)
-		copyArray(datas, src, t1);
-	if (key!= k2)
-		rewriteKeys(key,k2,datas);
+    //Releases all work space
+    void release();
 
+    //Counts pages of work space of threads (bit intervals, histograms, buffers) and returns
+    //how many of them lie on Numa nodes of their threads (see LOCAL_SCRATCH)
+    size_t localPages(size_t &pages) const;
 
-        if(timers!=NULL)
- 	    timers->timerEnd(5);
+private:
+    Sorter(const Sorter &);
+    Sorter & operator=(const Sorter &);
 
-       
-        if(timers!=NULL)
-	    for (int i = 2; i < 5; i++)
-		timers->finish(i);
+    //Prepares threads data and work space for t threads
+    void prepare(size_t N, int t, int bitCount, bool inPlace, bool withKeys, int valueArrays);
+
+    //Prepares work space and temporary arrays of sorting by the calling thread alone,
+    //returns false if N values are sorted by threads
+    bool prepareSequential(size_t N, bool withKeys, int valueArrays);
+
+    //Allocates temporary arrays of values and keys for N values
+    //(placed by the policy for t threads, by new if t is 0)
+    void reserveTemporary(size_t N, bool withKeys, int valueArrays, int t);
+
+    //Releases temporary arrays
+    void releaseTemporary();
+
+    //Chooses bitCount and number of threads when bitCount is 0, outputs the number of threads t
+    //of parallel regions of sorting and disables their dynamic adjustment,
+    //returns previous number of threads to be restored by restore (0 if it was not changed)
+    int tune(const Ti *src, size_t N, int &bitCount, size_t keySize, int &t);
+
+    //Restores the number of threads and dynamic adjustment changed by tune
+    void restore(int previous);
+
+    // type of counters
+    typedef typename RsortCounter<Tk>::type Tc;
+
+    // threads data
+    RsortData<Ti,Tc> *datas;
+
+    // number of threads and number of bits in one iteration threads data are allocated for
+    int threads;
+    int bits;
+
+    // work space of RSB and RSBInPlace
+    Tc *work;
+    size_t workSize;
+
+    // temporary arrays of values and keys
+    Ti *temp;
+    Tk *temp_key;
+
+    // length of temporary arrays of values and keys
+    // (argsort uses two temporary arrays of values placed one after another in temp)
+    size_t capacity;
+    size_t keyCapacity;
+
+    // temporary array allocated by the last prepare, it has to be first touched
+    Ti *untouched;
+
+    // temporary array of values is allocated by libnuma
+    bool numaTemp;
+
+    // placement policy
+    Policy policy;
 
+    // page size
+    int page_size;
+
+    // dynamic adjustment of the number of threads before tune
+    int dynamic;
+};
+
+template <class Ti, class Tk>
+Sorter<Ti,Tk>::Sorter(const Policy &policy) {
+	datas = NULL;
+	threads = 0;
+	bits = 0;
+	work = NULL;
+	workSize = 0;
+	temp = NULL;
+	temp_key = NULL;
+	capacity = 0;
+	keyCapacity = 0;
+	untouched = NULL;
+	numaTemp = false;
+	dynamic = 0;
+	setPolicy(policy);
 }
 
-/*	Parallel radix sort
- *
- * src - input array of values
- * key - output array of keys
- * N - number of values
- * bitCount - number of sorted bits in one iteration
- */
 template <class Ti, class Tk>
+void Sorter<Ti,Tk>::setPolicy(const Policy &policy) {
+	// threads data are placed again with the new placement of work space
+	if (datas != NULL && policy.localScratch != this->policy.localScratch) {
+		releaseThreadsData(threads, datas);
+		datas = NULL;
+		threads = 0;
+		bits = 0;
+	}
+	this->policy = policy;
+	page_size = pageSize<Ti>(policy.pageSizeIncluded);
+}
 
-void pradsort(Ti * src,Tk *key, const int N, int bitCount ,LVTimer *timers)
-{
-	Ti * temp = NULL;
-	Tk * temp_key = NULL;
-	RsortData<Ti> * datas;
-	int t = 0;
-#pragma omp parallel
-	if (omp_get_thread_num() == 0)
-		t = omp_get_num_threads();
+template <class Ti, class Tk>
+Sorter<Ti,Tk>::~Sorter() {
+	release();
+}
+
+template <class Ti, class Tk>
+void Sorter<Ti,Tk>::release() {
+	if (datas != NULL)
+		releaseThreadsData(threads, datas);
+	datas = NULL;
+	threads = 0;
+	bits = 0;
+	delete[] work;
+	work = NULL;
+	workSize = 0;
+	releaseTemporary();
+}
 
+template <class Ti, class Tk>
+size_t Sorter<Ti,Tk>::localPages(size_t &pages) const {
+	size_t local = 0;
+	pages = 0;
+	for (int i = 0; i < threads; i++)
+		local += datas[i].localPages(pages);
+	return local;
+}
+
+template <class Ti, class Tk>
+void Sorter<Ti,Tk>::releaseTemporary() {
 #ifdef linux
-	posix_memalign((void**) &datas, 64, t * sizeof(RsortData<Ti>));
+	if (numaTemp) {
+		if (temp != NULL)
+			numa_free(temp, capacity * sizeof(Ti));
+	} else
+		delete[] temp;
+	numaTemp = false;
 #endif
 #ifdef _WIN32
-	datas = (RsortData<Ti>*) _aligned_malloc(t*sizeof(RsortData<Ti>), 64);
-#endif
-	int page_size = 1;
-#if PAGE_SIZE_INCLUDED== 1
-#ifdef linux
-	page_size= numa_pagesize()/sizeof(Ti);
+	delete[] temp;
 #endif
-#ifdef _WIN32
+	delete[] temp_key;
+	temp = NULL;
+	temp_key = NULL;
+	capacity = 0;
+	keyCapacity = 0;
+	untouched = NULL;
+}
 
-	SYSTEM_INFO sInfo;
-	GetSystemInfo(&sInfo);
-	page_size = sInfo.dwPageSize / sizeof(Ti);
-#endif
-#endif
-	for(int i=0;i<t;i++){
-            datas[i].N=0;
-            datas[i].init(bitCount);
-            
-        }
-	set_index<Ti>(t, N / page_size, datas, true, page_size);
-	datas[t - 1].N += N - ((N / page_size) * page_size);
+template <class Ti, class Tk>
+int Sorter<Ti,Tk>::tune(const Ti *src, size_t N, int &bitCount, size_t keySize, int &t) {
+	int previous = omp_get_max_threads();
+	// threads data are split for t threads, so regions of sorting have to get all of them: inside a parallel region
+	// without active nested parallelism they get only the calling thread, and dynamic adjustment could give them fewer
+	int available = omp_get_active_level() >= omp_get_max_active_levels() ? 1 : previous;
+	if (available > omp_get_thread_limit())
+		available = omp_get_thread_limit();
+	dynamic = omp_get_dynamic();
+	omp_set_dynamic(0);
+	t = available;
+	if (bitCount <= 0)
+		tuneModel<Ti>().choose(N, estimateKeyBits(src, N), available, (double) (sizeof(Ti) + keySize) / sizeof(Ti), bitCount, t);
 
-#ifdef linux
-	temp_key = new Tk[N];
-#if NUMA==2
-#if NODE_BIND ==1
-	numa_tonode_memory(src,sizeof(Ti)*datas[t/2+1].start_i,0);
-#elif NODE_BIND==2 || CPU_BIND==1
-	if(t<=8)
-		numa_tonode_memory(src,sizeof(Ti)*N,0);
-	else
-		numa_tonode_memory(src,sizeof(Ti)*datas[8].start_i,0);
-#endif
-#endif
-#if NUMA ==1
+	// each thread sorts at least THREAD_VALUES values
+	if (THREAD_VALUES > 0 && (size_t) t > N / THREAD_VALUES)
+		t = N >= 2 * (size_t) THREAD_VALUES ? (int) (N / THREAD_VALUES) : 1;
+	if (t == previous)
+		return 0;
+	omp_set_num_threads(t);
+	return previous;
+}
 
-	temp = (Ti*) numa_alloc_interleaved(N * sizeof(Ti));
-#elif NUMA==2
+template <class Ti, class Tk>
+void Sorter<Ti,Tk>::restore(int previous) {
+	omp_set_dynamic(dynamic);
+	if (previous > 0)
+		omp_set_num_threads(previous);
+}
 
-	temp = (Ti*)numa_alloc_onnode(N*sizeof(Ti),1);
-	numa_tonode_memory(temp,sizeof(Ti)*(datas[t/2+1].start_i)/2,0);
+template <class Ti, class Tk>
+void Sorter<Ti,Tk>::prepare(size_t N, int t, int bitCount, bool inPlace, bool withKeys, int valueArrays) {
+	// threads data
+	if (t > threads || bitCount > bits) {
+		if (datas != NULL)
+			releaseThreadsData(threads, datas);
+		if (t > threads)
+			threads = t;
+		if (bitCount > bits)
+			bits = bitCount;
+		datas = createThreadsData<Ti,Tc>(threads, bits, policy.nodeBind, policy.localScratch > 0);
+	}
+	for (int i = 0; i < t; i++)
+		datas[i].setBitCount(bitCount);
+	splitValues<Ti,Tc>(t, (Tc) N, datas, page_size, policy.nodeBind);
+	for (int i = 0; i < t; i++)
+		datas[i].moveScratch();
 
-#else
-	temp = new Ti[N];
-#endif
+	// work space
+	int const bitIntervals = 1 << bitCount;
+	size_t digits = datas->digits;
+	size_t scan = 2 * (size_t) t * bitIntervals + t;
+	size_t needed = inPlace ? digits * (2 * (t + 1) * bitIntervals + 1) + 2 * (t + 1) * bitIntervals
+			: digits * bitIntervals + (scan > (1 << COUNTING_SORT_BITS) ? scan : (1 << COUNTING_SORT_BITS));
+	if (needed > workSize) {
+		delete[] work;
+		work = new Tc[needed];
+		workSize = needed;
+	}
+
+	if (inPlace)
+		return;
+
+	// write combining buffers (for digits of bitCount bits) and counters of digits of the next pass (for t threads
+	// and digits of bits bits, or as many of them as FUSED_COUNT_BITS allows) are allocated and touched by the thread
+	// that uses them (see scratchAlloc), in a parallel region entered only when some of them grow
+	size_t bufferSize = useWriteCombining<Ti,Tk>(bitCount) ? writeCombiningBufferSize<Ti,Tk>(1 << bitCount) : 0;
+	size_t nextSize = 0;
+	if (FUSED_COUNT && t > 1) {
+		nextSize = ((size_t) t + 2) << bits;
+		if (nextSize > ((size_t) 1 << FUSED_COUNT_BITS))
+			nextSize = (size_t) 1 << FUSED_COUNT_BITS;
+	}
+	bool grow = false;
+	for (int i = 0; i < t; i++)
+		grow = grow || datas[i].bufferSize < bufferSize || datas[i].nextSize < nextSize;
+	if (grow) {
+#pragma omp parallel num_threads(t)
+		{
+			int id = omp_get_thread_num();
+			if (datas[id].bufferSize < bufferSize) {
+				scratchFree(datas[id].buffer, datas[id].bufferSize, datas[id].local);
+				datas[id].buffer = (char *) scratchAlloc(bufferSize, datas[id].node, datas[id].local);
+				datas[id].bufferSize = bufferSize;
+			}
+			if (datas[id].nextSize < nextSize) {
+				scratchFree(datas[id].next, datas[id].nextSize * sizeof(Tc), datas[id].local);
+				datas[id].next = (Tc *) scratchAlloc(nextSize * sizeof(Tc), datas[id].node, datas[id].local);
+				datas[id].nextSize = nextSize;
+			}
+		}
+	}
+
+	// temporary arrays
+	untouched = NULL;
+	reserveTemporary(N, withKeys, valueArrays, t);
+}
+
+template <class Ti, class Tk>
+bool Sorter<Ti,Tk>::prepareSequential(size_t N, bool withKeys, int valueArrays) {
+	if (THREAD_VALUES <= 0 || N >= 2 * (size_t) THREAD_VALUES)
+		return false;
+
+	// histograms of 8-bit digits, then counters of passes of sortPartInPlace
+	size_t needed = 2 * 256 * sizeof(Ti);
+	if (needed > workSize) {
+		delete[] work;
+		work = new Tc[needed];
+		workSize = needed;
+	}
+	reserveTemporary(N, withKeys, valueArrays, 0);
+	// temporary arrays are touched by the sorting thread itself
+	untouched = NULL;
+	return true;
+}
+
+template <class Ti, class Tk>
+void Sorter<Ti,Tk>::reserveTemporary(size_t N, bool withKeys, int valueArrays, int t) {
+	size_t length = valueArrays * N;
+	if (length > capacity) {
+		Tk *kept_key = temp_key;
+		size_t kept = keyCapacity;
+		temp_key = NULL;
+		releaseTemporary();
+		temp_key = kept_key;
+		keyCapacity = kept;
+#ifdef linux
+		if (policy.numa == 1 && t > 0) {
+
+			temp = (Ti*) numa_alloc_interleaved(length * sizeof(Ti));
+		} else if (policy.numa == 2 && t > 0) {
+
+			temp = (Ti*)numa_alloc(length*sizeof(Ti));
+			for (int a = 0; a < valueArrays; a++)
+				placeOnNodes(t, datas, temp + a * N, sizeof(Ti));
+		} else
+			temp = new Ti[length];
+		numaTemp = policy.numa > 0 && t > 0;
 #endif
 #ifdef _WIN32
-	temp = new Ti[N];
-	temp_key = new Tk[N];
+		temp = new Ti[length];
 #endif
+		capacity = length;
+		untouched = temp;
+	}
+	// temporary keys array is allocated only when keys are sorted
+	if (withKeys && N > keyCapacity) {
+		delete[] temp_key;
+		temp_key = new Tk[N];
+		keyCapacity = N;
+	}
+}
+
+template <class Ti, class Tk>
+void Sorter<Ti,Tk>::reserve(size_t N, int bitCount) {
+	checkLength<Tk>(N);
+	if (prepareSequential(N, true, 1))
+		return;
+	int t;
+	int previous = tune(NULL, N, bitCount, sizeof(Tk), t);
+	prepare(N, t, bitCount, false, true, 1);
+
+	// First touch temporary array
+	binding<Ti,Tc>(t, datas, untouched, policy);
+	untouched = NULL;
+
+	// Unbinding
+	unbinding(t, datas);
+	restore(previous);
+}
+
+template <class Ti, class Tk>
+void Sorter<Ti,Tk>::sort(Ti *src, Tk *key, const size_t N, int bitCount, LVTimer *timers) {
+	checkLength<Tk>(N);
+	if (prepareSequential(N, key != NULL, 1)) {
+		radixSortSequential<Ti,Tk,Tc>(src, temp, key, temp_key, (Tc) N, work);
+		// keys of input values (see determineKey)
+		if (key != NULL) {
+			for (size_t i = 0; i < N; i++)
+				temp_key[key[i]] = (Tk) i;
+			for (size_t i = 0; i < N; i++)
+				key[i] = temp_key[i];
+		}
+		return;
+	}
+
+	int t;
+	int previous = tune(src, N, bitCount, key != NULL ? sizeof(Tk) : 0, t);
+	prepare(N, t, bitCount, false, key != NULL, 1);
+
+	if (policy.numa == 2)
+		placeOnNodes(t, datas, src, sizeof(Ti));
         if(timers!=NULL)
 	    timers->timerStart(0);
 
 
 	// Binding threads to Numa nodes and CPU cores
-	// First touch temporary array
-	binding<Ti>(t, N, datas, temp, page_size);
+	// First touch temporary array (only when it was allocated in this call)
+	binding<Ti,Tc>(t, datas, untouched, policy);
+	untouched = NULL;
 
 
         if(timers!=NULL)
 	    timers->timerEnd(0);
 
 	// proper sorting
-	RSB<Ti,Tk>(src, temp,key, temp_key,datas,N,bitCount, timers);
+	RSB<Ti,Tk,Tc>(src, temp,key, temp_key,datas,t,N,bitCount, work, useWriteCombining<Ti,Tk>(bitCount), timers);
 
 
 	// Unbinding
-#ifdef linux
-#pragma omp parallel
+	unbinding(t, datas);
+	restore(previous);
+}
 
-	numa_run_on_node_mask(numa_all_nodes_ptr);
-#endif
+template <class Ti, class Tk>
+void Sorter<Ti,Tk>::sort(Ti *src, const size_t N, int bitCount, LVTimer *timers) {
+	sort(src, (Tk *) NULL, N, bitCount, timers);
+}
+
+template <class Ti, class Tk>
+void Sorter<Ti,Tk>::argsort(const Ti *src, Tk *perm, const size_t N, int bitCount, LVTimer *timers) {
+	checkLength<Tk>(N);
+	if (prepareSequential(N, true, 2)) {
+		// a copy of values is sorted together with their indices
+		for (size_t i = 0; i < N; i++) {
+			temp[i] = src[i];
+			perm[i] = (Tk) i;
+		}
+		radixSortSequential<Ti,Tk,Tc>(temp, temp + N, perm, temp_key, (Tc) N, work);
+		return;
+	}
+
+	int t;
+	int previous = tune(src, N, bitCount, sizeof(Tk), t);
+	prepare(N, t, bitCount, false, true, 2);
+
+        if(timers!=NULL)
+	    timers->timerStart(0);
+
+
+	// Binding threads to Numa nodes and CPU cores
+	// First touch both temporary arrays of values (only when they were allocated in this call)
+	binding<Ti,Tc>(t, datas, untouched, policy);
+	if (untouched != NULL)
+		binding<Ti,Tc>(t, datas, untouched + N, policy);
+	untouched = NULL;
+
+
+        if(timers!=NULL)
+	    timers->timerEnd(0);
+
+	// proper sorting
+	RSBArgsort<Ti,Tk,Tc>(src, temp, temp + N, perm, temp_key, datas, t, N, bitCount, work, useWriteCombining<Ti,Tk>(bitCount), timers);
+
+
+	// Unbinding
+	unbinding(t, datas);
+	restore(previous);
+}
+
+template <class Ti, class Tk>
+void Sorter<Ti,Tk>::sortInPlace(Ti *src, Tk *key, const size_t N, int bitCount, LVTimer *timers) {
+	checkLength<Tk>(N, true);
+	if (prepareSequential(N, false, 0)) {
+		sortInPlaceSequential<Ti,Tk,Tc>(src, key, (Tc) N, work);
+		return;
+	}
+
+	int t;
+	int previous = tune(src, N, bitCount, sizeof(Tk), t);
+	prepare(N, t, bitCount, true, true, 1);
+
+        if(timers!=NULL)
+	    timers->timerStart(0);
+
+
+	// Binding threads to Numa nodes and CPU cores
+	binding<Ti,Tc>(t, datas, (Ti *) NULL, policy);
+
+
+        if(timers!=NULL)
+	    timers->timerEnd(0);
 
+	// proper sorting
+	RSBInPlace<Ti,Tk,Tc>(src, key, datas, t, N, bitCount, work, timers);
+
+
+	// Unbinding
+	unbinding(t, datas);
+	restore(previous);
+}
+
+/* Measuring the cost model of sorting values of type Ti on this host and saving it in the file of the host
+ * (random arrays of 16 MB are sorted with digits of 4 - TUNE_BITS bits by one thread and by all threads,
+ * it takes a few seconds, so it is meant to be run once, e.g. when the program is installed)
+ *
+ * Models are shared by all threads, so calibrate should not be run while other threads sort.
+ */
+template<class Ti>
+TuneModel calibrate() {
+	TuneModel model(sizeof(Ti));
+	size_t const N = (1 << 24) / sizeof(Ti);
+	Ti *values = new Ti[N];
+	Ti *sorted = new Ti[N];
+	uint64_t random = 88172645463325252ull;
+	unsigned char *bytes = (unsigned char *) values;
+	for (size_t i = 0; i < N * sizeof(Ti); i++) {
+		random ^= random << 13;
+		random ^= random >> 7;
+		random ^= random << 17;
+		bytes[i] = (unsigned char) random;
+	}
+	int threads = omp_get_max_threads();
+	Sorter<Ti> sorter;
+	for (int run = 0; run < 2; run++) {
+		omp_set_num_threads(run == 0 ? 1 : threads);
+		for (int b = 4; b <= TUNE_BITS; b++) {
+			double best = 0;
+			for (int repetition = 0; repetition < 2; repetition++) {
+				for (size_t i = 0; i < N; i++)
+					sorted[i] = values[i];
+				double start = omp_get_wtime();
+				sorter.sort(sorted, N, b, NULL);
+				double time = omp_get_wtime() - start;
+				if (repetition == 0 || time < best)
+					best = time;
+			}
+			int passes = (8 * sizeof(Ti) + b - 1) / b;
+			if (run == 0)
+				model.single[b] = best * 1e9 / passes / N;
+			else
+				model.all[b] = best * 1e9 / passes / N;
+		}
+	}
+	omp_set_num_threads(threads);
+
+	// cost of bit intervals of one pass, measured with digits of 16 bits
+	// (the first round only warms caches up)
+	{
+		typedef typename RsortCounter<int>::type Tc;
+		int const bitIntervals = 1 << 16;
+		int const rounds = 20;
+		RsortData<Ti,Tc> *datas = createThreadsData<Ti,Tc>(threads, 16, NODE_BIND, LOCAL_SCRATCH > 0);
+		Tc *scan = new Tc[2 * (size_t) threads * bitIntervals + threads + bitIntervals];
+		Tc *sum = scan + 2 * (size_t) threads * bitIntervals + threads;
+		double start = 0;
+#pragma omp parallel num_threads(threads)
+		{
+			RsortData<Ti,Tc> &mydata = datas[omp_get_thread_num()];
+			for (int round = 0; round <= rounds; round++) {
 #pragma omp barrier
-#ifdef _WIN32
-	_aligned_free(datas);
-#endif
-#ifdef linux
-	free(datas);
-#endif
+#pragma omp master
+				if (round == 1)
+					start = omp_get_wtime();
+				for (int i = 0; i < bitIntervals; i++)
+					mydata.bits[i] = 1;
+#pragma omp barrier
+				addHistograms(datas, &RsortData<Ti,Tc>::bits, sum, bitIntervals);
+				calculateStartingIndices(omp_get_num_threads(), datas, scan, (Tc) 0, bitIntervals);
+			}
+		}
+		model.merge = (omp_get_wtime() - start) * 1e9 / rounds / bitIntervals;
+		releaseThreadsData(threads, datas);
+		delete[] scan;
+	}
 
-#ifdef linux
-	delete[] temp_key;
-#if NUMA>0
-	numa_free(temp, N * sizeof(Ti));
-#else
-	delete[] temp;
-#endif
-#endif
-#ifdef _WIN32
-	delete[] temp;
-#endif
+	// cost of parallel regions
+	int const regions = 1000;
+	int counted = 0;
+	double start = omp_get_wtime();
+	for (int i = 0; i < regions; i++) {
+#pragma omp parallel
+		if (omp_get_thread_num() == 0)
+			counted++;
+	}
+	model.region = (omp_get_wtime() - start) * 1e9 / regions;
+	model.threads = threads;
+	delete[] values;
+	delete[] sorted;
 
+	tuneCache().model(sizeof(Ti)) = model;
+	tuneCache().save();
+	return model;
 }
+
+/*	Parallel radix sort
+ *
+ * Work space is allocated in each call, Sorter keeps it between calls.
+ *
+ * src - input array of values
+ * key - output array of keys
+ * N - number of values
+ * bitCount - number of sorted bits in one iteration (0 - chosen with the number of threads by the cost model)
+ * policy - placement policy of threads and memory (default given by macros)
+ */
+template <class Ti, class Tk>
+
+void pradsort(Ti * src,Tk *key, const size_t N, int bitCount ,LVTimer *timers, const Policy &policy = Policy())
+{
+	Sorter<Ti,Tk> sorter(policy);
+	sorter.sort(src, key, N, bitCount, timers);
+}
+
+/*	Parallel radix sort of values only
+ *
+ * No keys are determined, so neither keys array nor temporary keys array is used.
+ *
+ * src - input array of values
+ * N - number of values
+ * bitCount - number of sorted bits in one iteration (0 - chosen with the number of threads by the cost model)
+ * policy - placement policy of threads and memory (default given by macros)
+ */
+template <class Ti>
+
+void pradsort(Ti * src, const size_t N, int bitCount ,LVTimer *timers, const Policy &policy = Policy())
+{
+	// 32-bit counters are enough for up to 2^31 - 1 values
+	if (N > (size_t) INT_MAX) {
+		Sorter<Ti,long long> sorter(policy);
+		sorter.sort(src, N, bitCount, timers);
+	} else {
+		Sorter<Ti> sorter(policy);
+		sorter.sort(src, N, bitCount, timers);
+	}
+}
+
+/*	Parallel radix argsort
+ *
+ * Input array is not modified, only the sorting permutation is determined.
+ *
+ * src - input array of values
+ * perm - output permutation (perm[i] - index in src of the i-th smallest value)
+ * N - number of values
+ * bitCount - number of sorted bits in one iteration (0 - chosen with the number of threads by the cost model)
+ * policy - placement policy of threads and memory (default given by macros)
+ */
+template <class Ti, class Tk>
+
+void pradargsort(const Ti * src,Tk *perm, const size_t N, int bitCount ,LVTimer *timers, const Policy &policy = Policy())
+{
+	Sorter<Ti,Tk> sorter(policy);
+	sorter.argsort(src, perm, N, bitCount, timers);
 }
-#endif
 
+/*	Parallel in-place radix sort
+ *
+ * Sorting is performed from the most significant digit and needs no temporary arrays
+ * of values and keys, extra memory is proportional to the number of threads and bit intervals.
+ * Sorting is not stable.
+ *
+ * src - input array of values
+ * key - output array of keys
+ * N - number of values
+ * bitCount - number of sorted bits in one iteration (0 - chosen with the number of threads by the cost model)
+ * policy - placement policy of threads and memory (default given by macros)
+ */
+template <class Ti, class Tk>
+void pradsortInPlace(Ti * src,Tk *key, const size_t N, int bitCount ,LVTimer *timers, const Policy &policy = Policy())
+{
+	Sorter<Ti,Tk> sorter(policy);
+	sorter.sortInPlace(src, key, N, bitCount, timers);
+}
+}
+#endif
 
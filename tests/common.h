@@ -14,6 +14,7 @@
 #include <ctime>
 #include <omp.h>
 #endif
+#include <cmath>
 #include "testdata.h"
 #include "timers.h"
 #define FLUSH_CACHE 1 // 1 - turns on cleaning L2, L3 memory before calculations
@@ -81,6 +82,58 @@ bool checkKey(Ti *dataIn, Ti *sorted, Tk *key, int N)
 
 }
 
+/**
+ * Rank of floating point value in the order of pradsort: NaNs with the sign bit are placed
+ * before other values when nanLast is false, other NaNs after them (see NAN_PLACEMENT)
+ */
+template<class Tf>
+int floatRank(const Tf x, bool nanLast) {
+	if (x == x)
+		return 1;
+	return (!nanLast && std::signbit(x)) ? 0 : 2;
+}
+
+/**
+ * Checks if floating point values are sorted like pradsort sorts them:
+ * numerical order, -0.0 before 0.0 and NaNs placed by floatRank
+ *
+ * return value: true  - values are sorted,
+ *               false - some values are not sorted.
+ */
+template<class Tf>
+bool checkFloatOrder(const Tf * x, const int N, bool nanLast) {
+	int error = 0;
+	for (int i = 1; i < N; i++) {
+		int previous = floatRank(x[i - 1], nanLast);
+		int current = floatRank(x[i], nanLast);
+		if (previous > current || (previous == 1 && current == 1 && (x[i - 1] > x[i]
+				|| (x[i - 1] == x[i] && !std::signbit(x[i - 1]) && std::signbit(x[i])))))
+			error++;
+	}
+	if (error) {
+		printf("[checkFloatOrder] Error occured in sorting. Number of values out of order: %d\n", error);
+		return false;
+	} else {
+		printf("[checkFloatOrder] The result of the sort is correct.\n");
+		return true;
+	}
+}
+
+/**
+ * Checks keys of sorted floating point values like checkKey (NaNs match any NaN,
+ * their sign bit may be lost by sorting)
+ */
+template<class Tf,class Tk>
+bool checkFloatKey(const Tf *dataIn, const Tf *sorted, const Tk *key, int N)
+{
+	for(int i=0;i<N;i++)
+	{
+		if(dataIn[i]!=sorted[key[i]] && (dataIn[i]==dataIn[i] || sorted[key[i]]==sorted[key[i]])) return false;
+	}
+	return true;
+
+}
+
 template <class Ti>
 Ti * readVector(int N, char * fileName) {
 	FILE *fp;
@@ -98,4 +151,39 @@ Ti * readVector(int N, char * fileName) {
 
 void setThreadsNo(int t, int maxThreads);
 
+/**
+ * Copies input data to the sorted array and sets keys to indices of values
+ * (like before the timed sort, input data are arranged by threads, see NUMA_4_INPUT_DATA),
+ * then t threads are set for sorting
+ *
+ * key - array of keys (NULL if keys are not used)
+ */
+template<class Ti>
+void resetInput(const Ti * dataIn, Ti * dataRadix, int * key, int N, int t, int maxThreads) {
+	int i;
+	setThreadsNo(t, maxThreads);
+#pragma omp parallel for private(i) default(shared)
+	for (i = 0; i < N; i++) {
+		dataRadix[i] = dataIn[i];
+		if (key != NULL)
+			key[i] = i;
+	}
+	omp_set_num_threads(t);
+}
+
+/**
+ * Sorts a copy of input data, the reference for checkResults
+ */
+template<class Ti>
+void sortReference(const Ti * dataIn, Ti * dataSTL, int N) {
+	for (int i = 0; i < N; i++)
+		dataSTL[i] = dataIn[i];
+#ifdef linux
+	__gnu_parallel::sort(dataSTL, dataSTL + N);
+#endif
+#ifdef _WIN32
+	std::sort(dataSTL, dataSTL + N);
+#endif
+}
+
 #endif
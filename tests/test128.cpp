@@ -155,7 +155,7 @@ int main(int argc, char* argv[]) {
     if(argc >3){
         int tmp;
         tmp = (int) strtol(argv[3], NULL, 10);
-        if ((tmp > 0) && (tmp<=16 )) // limit bit count
+        if ((tmp >= 0) && (tmp<=16 )) // limit bit count (0 - chosen by the cost model)
             bitCount = tmp;
     }        
     if(argc >4){
@@ -311,6 +311,73 @@ int main(int argc, char* argv[]) {
 #endif
     }
 
+// entry points other than pradsort are run with maxThreads threads and checked against sorted input data
+    VTimer entryTimes(1);
+    sortReference(dataIn, dataSTL, N);
+
+// in place radix sort
+    for (it = 0; it < repetitions; it++) {
+        resetInput(dataIn, dataRadix, key, N, maxThreads, maxThreads);
+        entryTimes.timerStart(0);
+        prsort::pradsortInPlace<int128,int>(dataRadix, key, N, bitCount, NULL);
+        entryTimes.timerEnd(0);
+    }
+    printf("|RADIX SORT IN PLACE (th=%2d)  : %1.3fs  |\t", maxThreads, entryTimes.getTime(0));
+    checkResults(dataSTL, dataRadix, N);
+    printf(checkKey(dataIn, dataRadix, key, N) ? "Keys are good\n" : "Keys are wrong\n");
+
+// sorter reused for arrays of other length and digits, its work space is kept between calls
+    {
+        prsort::Sorter<int128,int> sorter;
+        int const lengths[3] = {N, N / 2, N};
+        for (int run = 0; run < 3; run++) {
+            int const M = lengths[run];
+            int const bits = run == 1 ? (bitCount == 8 ? 11 : 8) : bitCount;
+            sortReference(dataIn, dataSTL, M);
+            resetInput(dataIn, dataRadix, key, M, maxThreads, maxThreads);
+            entryTimes.reset();
+            entryTimes.timerStart(0);
+            sorter.sort(dataRadix, key, M, bits, NULL);
+            entryTimes.timerEnd(0);
+            printf("|RADIX SORTER (th=%2d, N=%d, bit_count=%d)  : %1.3fs  |\t", maxThreads, M, bits, entryTimes.getTime(0));
+            checkResults(dataSTL, dataRadix, M);
+            printf(checkKey(dataIn, dataRadix, key, M) ? "Keys are good\n" : "Keys are wrong\n");
+        }
+    }
+
+// values only radix sort, no keys are determined
+    entryTimes.reset();
+    for (it = 0; it < repetitions; it++) {
+        resetInput(dataIn, dataRadix, (int *) NULL, N, maxThreads, maxThreads);
+        entryTimes.timerStart(0);
+        prsort::pradsort<int128>(dataRadix, N, bitCount, NULL);
+        entryTimes.timerEnd(0);
+    }
+    printf("|RADIX SORT VALUES ONLY (th=%2d)  : %1.3fs  |\t", maxThreads, entryTimes.getTime(0));
+    checkResults(dataSTL, dataRadix, N);
+
+// argsort, input is left untouched and the sorting permutation is returned in keys
+    entryTimes.reset();
+    for (it = 0; it < repetitions; it++) {
+        resetInput(dataIn, dataRadix, key, N, maxThreads, maxThreads);
+        entryTimes.timerStart(0);
+        prsort::pradargsort<int128,int>(dataRadix, key, N, bitCount, NULL);
+        entryTimes.timerEnd(0);
+    }
+    printf("|RADIX ARGSORT (th=%2d)  : %1.3fs  |\t", maxThreads, entryTimes.getTime(0));
+    {
+        bool untouched = true;
+        int128 * permuted = new int128[N];
+        for (int i = 0; i < N; i++) {
+            if (dataRadix[i] != dataIn[i])
+                untouched = false;
+            permuted[i] = dataRadix[key[i]];
+        }
+        checkResults(dataSTL, permuted, N);
+        printf(untouched ? "Input is untouched\n" : "Input was changed\n");
+        delete[] permuted;
+    }
+
 #ifdef linux
     delete[] key;
 #if NUMA>0
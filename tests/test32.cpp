@@ -60,7 +60,7 @@ int main(int argc, char* argv[]) {
         if(argc >3){
              int tmp;
 	    tmp = (int) strtol(argv[3], NULL, 10);
-	    if ((tmp > 0) && (tmp<=16 )) // limit bit count
+	    if ((tmp >= 0) && (tmp<=16 )) // limit bit count (0 - chosen by the cost model)
 		bitCount = tmp;
         }        
         if(argc >4){
@@ -216,6 +216,186 @@ int main(int argc, char* argv[]) {
 #endif
 	}
 
+// entry points other than pradsort are run with maxThreads threads and checked against sorted input data
+	VTimer entryTimes(1);
+	sortReference(dataIn, dataSTL, N);
+
+// in place radix sort
+	for (it = 0; it < repetitions; it++) {
+		resetInput(dataIn, dataRadix, key, N, maxThreads, maxThreads);
+		entryTimes.timerStart(0);
+		prsort::pradsortInPlace<int,int>(dataRadix, key, N, bitCount, NULL);
+		entryTimes.timerEnd(0);
+	}
+	printf("|RADIX SORT IN PLACE (th=%2d)  : %1.3fs  |\t", maxThreads, entryTimes.getTime(0));
+	checkResults(dataSTL, dataRadix, N);
+	printf(checkKey(dataIn, dataRadix, key, N) ? "Keys are good\n" : "Keys are wrong\n");
+
+// sorter reused for arrays of other length and digits, its work space is kept between calls
+	{
+		prsort::Sorter<int,int> sorter;
+		int const lengths[3] = {N, N / 2, N};
+		for (int run = 0; run < 3; run++) {
+			int const M = lengths[run];
+			int const bits = run == 1 ? (bitCount == 8 ? 11 : 8) : bitCount;
+			sortReference(dataIn, dataSTL, M);
+			resetInput(dataIn, dataRadix, key, M, maxThreads, maxThreads);
+			entryTimes.reset();
+			entryTimes.timerStart(0);
+			sorter.sort(dataRadix, key, M, bits, NULL);
+			entryTimes.timerEnd(0);
+			printf("|RADIX SORTER (th=%2d, N=%d, bit_count=%d)  : %1.3fs  |\t", maxThreads, M, bits, entryTimes.getTime(0));
+			checkResults(dataSTL, dataRadix, M);
+			printf(checkKey(dataIn, dataRadix, key, M) ? "Keys are good\n" : "Keys are wrong\n");
+		}
+	}
+
+// values only radix sort, no keys are determined
+	entryTimes.reset();
+	for (it = 0; it < repetitions; it++) {
+		resetInput(dataIn, dataRadix, (int *) NULL, N, maxThreads, maxThreads);
+		entryTimes.timerStart(0);
+		prsort::pradsort<int>(dataRadix, N, bitCount, NULL);
+		entryTimes.timerEnd(0);
+	}
+	printf("|RADIX SORT VALUES ONLY (th=%2d)  : %1.3fs  |\t", maxThreads, entryTimes.getTime(0));
+	checkResults(dataSTL, dataRadix, N);
+
+// argsort, input is left untouched and the sorting permutation is returned in keys
+	entryTimes.reset();
+	for (it = 0; it < repetitions; it++) {
+		resetInput(dataIn, dataRadix, key, N, maxThreads, maxThreads);
+		entryTimes.timerStart(0);
+		prsort::pradargsort<int,int>(dataRadix, key, N, bitCount, NULL);
+		entryTimes.timerEnd(0);
+	}
+	printf("|RADIX ARGSORT (th=%2d)  : %1.3fs  |\t", maxThreads, entryTimes.getTime(0));
+	{
+		bool untouched = true;
+		int * permuted = new int[N];
+		for (int i = 0; i < N; i++) {
+			if (dataRadix[i] != dataIn[i])
+				untouched = false;
+			permuted[i] = dataRadix[key[i]];
+		}
+		checkResults(dataSTL, permuted, N);
+		printf(untouched ? "Input is untouched\n" : "Input was changed\n");
+		delete[] permuted;
+	}
+
+// signed values, every second value is negated
+	{
+		int * dataSigned = new int[N];
+		for (int i = 0; i < N; i++)
+			dataSigned[i] = (i & 1) ? -dataIn[i] : dataIn[i];
+		sortReference(dataSigned, dataSTL, N);
+		entryTimes.reset();
+		for (it = 0; it < repetitions; it++) {
+			resetInput(dataSigned, dataRadix, key, N, maxThreads, maxThreads);
+			entryTimes.timerStart(0);
+			prsort::pradsort<int,int>(dataRadix, key, N, bitCount, NULL);
+			entryTimes.timerEnd(0);
+		}
+		printf("|RADIX SORT SIGNED (th=%2d)  : %1.3fs  |\t", maxThreads, entryTimes.getTime(0));
+		checkResults(dataSTL, dataRadix, N);
+		printf(checkKey(dataSigned, dataRadix, key, N) ? "Keys are good\n" : "Keys are wrong\n");
+		delete[] dataSigned;
+		sortReference(dataIn, dataSTL, N);
+	}
+
+// float values with negative numbers, zeros of both signs, infinities and NaNs of both signs
+	{
+		float * floatIn = new float[N];
+		float * floatRadix = new float[N];
+		for (int i = 0; i < N; i++) {
+			float value = (float) dataIn[i] / 7;
+			switch (i % 64) {
+			case 0: value = std::numeric_limits<float>::quiet_NaN(); break;
+			case 1: value = -std::numeric_limits<float>::quiet_NaN(); break;
+			case 2: value = 0; break;
+			case 3: value = -(float) 0; break;
+			case 4: value = std::numeric_limits<float>::infinity(); break;
+			case 5: value = -std::numeric_limits<float>::infinity(); break;
+			default: if (i & 1) value = -value;
+			}
+			floatIn[i] = value;
+		}
+		entryTimes.reset();
+		for (it = 0; it < repetitions; it++) {
+			resetInput(floatIn, floatRadix, key, N, maxThreads, maxThreads);
+			entryTimes.timerStart(0);
+			prsort::pradsort<float,int>(floatRadix, key, N, bitCount, NULL);
+			entryTimes.timerEnd(0);
+		}
+		printf("|RADIX SORT FLOAT (th=%2d)  : %1.3fs  |\t", maxThreads, entryTimes.getTime(0));
+		checkFloatOrder(floatRadix, N, NAN_PLACEMENT == 1);
+		printf(checkFloatKey(floatIn, floatRadix, key, N) ? "Keys are good\n" : "Keys are wrong\n");
+		delete[] floatIn;
+		delete[] floatRadix;
+	}
+
+// work space of threads allocated by the calling thread and by threads on their Numa nodes (LOCAL_SCRATCH),
+// every access of a thread to a page of its work space on another node is remote
+	for (int local = 0; local <= 1; local++) {
+		Policy policy;
+		policy.localScratch = local;
+		Sorter<int,int> sorter(policy);
+		VTimer scratchTimes(1);
+		for (it = 0; it < repetitions; it++) {
+			resetInput(dataIn, dataRadix, key, N, maxThreads, maxThreads);
+			scratchTimes.timerStart(0);
+			sorter.sort(dataRadix, key, N, bitCount, NULL);
+			scratchTimes.timerEnd(0);
+		}
+		size_t pages = 0;
+		size_t localPages = sorter.localPages(pages);
+		printf("|RADIX SORT (th=%2d, LOCAL_SCRATCH:%d) : %1.3fs, work space pages of threads on their nodes: %lu of %lu (%lu remote)|\t",
+				maxThreads, local, scratchTimes.getTime(0), (unsigned long) localPages, (unsigned long) pages,
+				(unsigned long) (pages - localPages));
+		checkResults(dataSTL, dataRadix, N);
+		printf(checkKey(dataIn, dataRadix, key, N) ? "Keys are good\n" : "Keys are wrong\n");
+	}
+
+// sorts called by threads of an enclosing parallel region, by pradsort and by a Sorter of each thread
+// (without active nested parallelism regions of sorting get only the calling thread)
+	{
+		int const callers = 2;
+		int * nestedRadix = new int[(size_t) callers * N];
+		int * nestedKey = new int[(size_t) callers * N];
+		for (int withSorter = 0; withSorter <= 1; withSorter++) {
+			// dynamic adjustment (OMP_DYNAMIC) may give the enclosing region fewer callers
+			int ran = callers;
+			setThreadsNo(maxThreads, maxThreads);
+			entryTimes.reset();
+			entryTimes.timerStart(0);
+#pragma omp parallel num_threads(callers)
+			{
+				int * values = nestedRadix + (size_t) omp_get_thread_num() * N;
+				int * keys = nestedKey + (size_t) omp_get_thread_num() * N;
+				if (omp_get_thread_num() == 0)
+					ran = omp_get_num_threads();
+				for (int i = 0; i < N; i++) {
+					values[i] = dataIn[i];
+					keys[i] = i;
+				}
+				if (withSorter == 1) {
+					Sorter<int,int> nested;
+					nested.sort(values, keys, N, bitCount, NULL);
+				} else
+					prsort::pradsort<int,int>(values, keys, N, bitCount, NULL);
+			}
+			entryTimes.timerEnd(0);
+			for (int c = 0; c < ran; c++) {
+				printf("|RADIX SORT NESTED (%s, caller %d of %d) : %1.3fs  |\t", withSorter == 1 ? "Sorter" : "pradsort",
+						c + 1, ran, entryTimes.getTime(0));
+				checkResults(dataSTL, nestedRadix + (size_t) c * N, N);
+				printf(checkKey(dataIn, nestedRadix + (size_t) c * N, nestedKey + (size_t) c * N, N) ? "Keys are good\n" : "Keys are wrong\n");
+			}
+		}
+		delete[] nestedRadix;
+		delete[] nestedKey;
+	}
+
 #ifdef linux
 	delete[] key;
 #if NUMA>0
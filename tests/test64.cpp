@@ -60,7 +60,7 @@ int main(int argc, char* argv[]) {
         if(argc >3){
              int tmp;
 	    tmp = (int) strtol(argv[3], NULL, 10);
-	    if ((tmp > 0) && (tmp<=16 )) // limit bit count
+	    if ((tmp >= 0) && (tmp<=16 )) // limit bit count (0 - chosen by the cost model)
 		bitCount = tmp;
         }        
         if(argc >4){
@@ -217,6 +217,124 @@ int main(int argc, char* argv[]) {
 #endif
 	}
 
+// entry points other than pradsort are run with maxThreads threads and checked against sorted input data
+	VTimer entryTimes(1);
+	sortReference(dataIn, dataSTL, N);
+
+// in place radix sort
+	for (it = 0; it < repetitions; it++) {
+		resetInput(dataIn, dataRadix, key, N, maxThreads, maxThreads);
+		entryTimes.timerStart(0);
+		prsort::pradsortInPlace<long,int>(dataRadix, key, N, bitCount, NULL);
+		entryTimes.timerEnd(0);
+	}
+	printf("|RADIX SORT IN PLACE (th=%2d)  : %1.3fs  |\t", maxThreads, entryTimes.getTime(0));
+	checkResults(dataSTL, dataRadix, N);
+	printf(checkKey(dataIn, dataRadix, key, N) ? "Keys are good\n" : "Keys are wrong\n");
+
+// sorter reused for arrays of other length and digits, its work space is kept between calls
+	{
+		prsort::Sorter<long,int> sorter;
+		int const lengths[3] = {N, N / 2, N};
+		for (int run = 0; run < 3; run++) {
+			int const M = lengths[run];
+			int const bits = run == 1 ? (bitCount == 8 ? 11 : 8) : bitCount;
+			sortReference(dataIn, dataSTL, M);
+			resetInput(dataIn, dataRadix, key, M, maxThreads, maxThreads);
+			entryTimes.reset();
+			entryTimes.timerStart(0);
+			sorter.sort(dataRadix, key, M, bits, NULL);
+			entryTimes.timerEnd(0);
+			printf("|RADIX SORTER (th=%2d, N=%d, bit_count=%d)  : %1.3fs  |\t", maxThreads, M, bits, entryTimes.getTime(0));
+			checkResults(dataSTL, dataRadix, M);
+			printf(checkKey(dataIn, dataRadix, key, M) ? "Keys are good\n" : "Keys are wrong\n");
+		}
+	}
+
+// values only radix sort, no keys are determined
+	entryTimes.reset();
+	for (it = 0; it < repetitions; it++) {
+		resetInput(dataIn, dataRadix, (int *) NULL, N, maxThreads, maxThreads);
+		entryTimes.timerStart(0);
+		prsort::pradsort<long>(dataRadix, N, bitCount, NULL);
+		entryTimes.timerEnd(0);
+	}
+	printf("|RADIX SORT VALUES ONLY (th=%2d)  : %1.3fs  |\t", maxThreads, entryTimes.getTime(0));
+	checkResults(dataSTL, dataRadix, N);
+
+// argsort, input is left untouched and the sorting permutation is returned in keys
+	entryTimes.reset();
+	for (it = 0; it < repetitions; it++) {
+		resetInput(dataIn, dataRadix, key, N, maxThreads, maxThreads);
+		entryTimes.timerStart(0);
+		prsort::pradargsort<long,int>(dataRadix, key, N, bitCount, NULL);
+		entryTimes.timerEnd(0);
+	}
+	printf("|RADIX ARGSORT (th=%2d)  : %1.3fs  |\t", maxThreads, entryTimes.getTime(0));
+	{
+		bool untouched = true;
+		long * permuted = new long[N];
+		for (int i = 0; i < N; i++) {
+			if (dataRadix[i] != dataIn[i])
+				untouched = false;
+			permuted[i] = dataRadix[key[i]];
+		}
+		checkResults(dataSTL, permuted, N);
+		printf(untouched ? "Input is untouched\n" : "Input was changed\n");
+		delete[] permuted;
+	}
+
+// signed values, every second value is negated
+	{
+		long * dataSigned = new long[N];
+		for (int i = 0; i < N; i++)
+			dataSigned[i] = (i & 1) ? -dataIn[i] : dataIn[i];
+		sortReference(dataSigned, dataSTL, N);
+		entryTimes.reset();
+		for (it = 0; it < repetitions; it++) {
+			resetInput(dataSigned, dataRadix, key, N, maxThreads, maxThreads);
+			entryTimes.timerStart(0);
+			prsort::pradsort<long,int>(dataRadix, key, N, bitCount, NULL);
+			entryTimes.timerEnd(0);
+		}
+		printf("|RADIX SORT SIGNED (th=%2d)  : %1.3fs  |\t", maxThreads, entryTimes.getTime(0));
+		checkResults(dataSTL, dataRadix, N);
+		printf(checkKey(dataSigned, dataRadix, key, N) ? "Keys are good\n" : "Keys are wrong\n");
+		delete[] dataSigned;
+		sortReference(dataIn, dataSTL, N);
+	}
+
+// double values with negative numbers, zeros of both signs, infinities and NaNs of both signs
+	{
+		double * floatIn = new double[N];
+		double * floatRadix = new double[N];
+		for (int i = 0; i < N; i++) {
+			double value = (double) dataIn[i] / 7;
+			switch (i % 64) {
+			case 0: value = std::numeric_limits<double>::quiet_NaN(); break;
+			case 1: value = -std::numeric_limits<double>::quiet_NaN(); break;
+			case 2: value = 0; break;
+			case 3: value = -(double) 0; break;
+			case 4: value = std::numeric_limits<double>::infinity(); break;
+			case 5: value = -std::numeric_limits<double>::infinity(); break;
+			default: if (i & 1) value = -value;
+			}
+			floatIn[i] = value;
+		}
+		entryTimes.reset();
+		for (it = 0; it < repetitions; it++) {
+			resetInput(floatIn, floatRadix, key, N, maxThreads, maxThreads);
+			entryTimes.timerStart(0);
+			prsort::pradsort<double,int>(floatRadix, key, N, bitCount, NULL);
+			entryTimes.timerEnd(0);
+		}
+		printf("|RADIX SORT DOUBLE (th=%2d)  : %1.3fs  |\t", maxThreads, entryTimes.getTime(0));
+		checkFloatOrder(floatRadix, N, NAN_PLACEMENT == 1);
+		printf(checkFloatKey(floatIn, floatRadix, key, N) ? "Keys are good\n" : "Keys are wrong\n");
+		delete[] floatIn;
+		delete[] floatRadix;
+	}
+
 #ifdef linux
 	delete[] key;
 #if NUMA>0